@@ -0,0 +1,423 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>  // max, min, shuffle, swap
+#include <bit>  // popcount
+#include <chrono>
+#include <cmath>  // exp, log2
+#include <cstddef>  // size_t
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>  // malloc_usable_size
+#endif
+
+#include "mr-cfg/cfg.hpp"
+#include "mr-cfg/cost.hpp"
+#include "mr-cfg/interval.hpp"
+
+using namespace std;
+using namespace mr_cfg;
+
+
+// the number of positions the interval families are in
+const uint64_t N = 1 << 24;
+// the depths of the families; with two children per interval, their deepest
+// levels have about 2^7, 2^11, 2^15, 2^19, and 2^23 interval boundaries, i.e.
+// the boundaries StabberCalibration's costs are measured at
+const uint64_t DEPTHS[5] = {5, 9, 13, 17, 21};
+
+// the results of the measured operations are written here so that they can't
+// be optimized away
+volatile uint64_t sink;
+
+
+// the bytes currently and at most allocated on the heap; with glibc, malloc is
+// interposed and the usable size of each allocation is counted, otherwise
+// nothing is
+uint64_t allocated_bytes = 0;
+uint64_t peak_bytes = 0;
+
+#ifdef __GLIBC__
+//! Counts an allocation that was made or freed.
+void countAllocation(void* pointer, bool freed) {
+  if (pointer == NULL) {
+    return;
+  }
+  if (freed) {
+    allocated_bytes -= malloc_usable_size(pointer);
+  } else {
+    allocated_bytes += malloc_usable_size(pointer);
+    peak_bytes = max(peak_bytes, allocated_bytes);
+  }
+}
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void __libc_free(void* pointer);
+
+void* malloc(size_t size) noexcept {
+  void* pointer = __libc_malloc(size);
+  countAllocation(pointer, false);
+  return pointer;
+}
+
+void* calloc(size_t count, size_t size) noexcept {
+  void* pointer = __libc_calloc(count, size);
+  countAllocation(pointer, false);
+  return pointer;
+}
+
+void* realloc(void* pointer, size_t size) noexcept {
+  countAllocation(pointer, true);
+  void* reallocated = __libc_realloc(pointer, size);
+  countAllocation(reallocated == NULL ? pointer : reallocated, false);
+  return reallocated;
+}
+
+void free(void* pointer) noexcept {
+  countAllocation(pointer, true);
+  __libc_free(pointer);
+}
+}
+#endif
+
+
+//! An interval of a laminar family.
+struct LaminarInterval
+{
+  uint64_t begin;
+  uint64_t end;
+  uint64_t depth;
+};
+
+
+//! The costs of a dynamic interval stabbing data-structure measured with one
+//  laminar family.
+struct Measurement
+{
+  double update_ns;
+  double stab_ns;
+  double boundary_ns;
+  double interval_bytes;
+};
+
+
+void usage(char* argv[]) {
+  cerr << "Usage: " << argv[0] << " [QUERIES] [REPETITIONS] [SEED]" << endl;
+}
+
+
+//! Returns the nanoseconds elapsed since the given time.
+double elapsed(const chrono::high_resolution_clock::time_point& start) {
+  chrono::duration<double, nano> duration =
+    chrono::high_resolution_clock::now() - start;
+  return duration.count();
+}
+
+
+//! Generates a random laminar family of intervals in [0, n-1) with two
+//  children of similar widths per interval, level by level, as
+//  MR-CFG-bench-laminar's UNIFORM LEVEL families with a fanout of 2.
+vector<LaminarInterval>
+generateLaminarFamily(uint64_t n, uint64_t depth, mt19937_64& rng) {
+  vector<LaminarInterval> intervals;
+  // the virtual root spans every position and isn't itself an interval
+  queue<LaminarInterval> parents;
+  parents.push({0, n-2, 0});
+  while (!parents.empty()) {
+    const LaminarInterval parent = parents.front();
+    parents.pop();
+    if (parent.depth == depth) {
+      continue;
+    }
+    // children must be narrower than their parent, except at the top level
+    const bool is_root = parent.depth == 0;
+    uint64_t width = parent.end - parent.begin + (is_root ? 1 : 0);
+    if (width < 4) {
+      continue;
+    }
+    // children shrink slowly enough that chains can reach the max depth
+    const uint64_t levels = depth - parent.depth;
+    uint64_t slot_begin = parent.begin;
+    for (uint64_t remaining = 2; remaining > 0; --remaining) {
+      const uint64_t slot_width = width / remaining;
+      width -= slot_width;
+      uniform_int_distribution<uint64_t> child_width(
+        max<uint64_t>(2, slot_width - slot_width / (levels + 1)), slot_width);
+      const uint64_t w = child_width(rng);
+      uniform_int_distribution<uint64_t> offset(0, slot_width - w);
+      const uint64_t begin = slot_begin + offset(rng);
+      const LaminarInterval child{begin, begin + w - 1, parent.depth + 1};
+      intervals.push_back(child);
+      parents.push(child);
+      slot_begin += slot_width;
+    }
+  }
+  return intervals;
+}
+
+
+//! Updates a data-structure with every interval of a family, stabs it at the
+//  query positions, and gets its boundaries, measuring the cost of each per
+//  interval, query, and boundary, and the peak bytes allocated per interval.
+Measurement measure(
+  const string& algorithm,
+  const vector<LaminarInterval>& intervals,
+  const vector<uint32_t>& queries)
+{
+  Measurement measurement;
+  const uint64_t allocated = allocated_bytes;
+  peak_bytes = allocated_bytes;
+  unique_ptr<NestedIntervalStabber<CFG_rule, uint32_t>> stabber;
+  if (algorithm == "ONLINE") {
+    stabber.reset(new OnlineNestedIntervalStabber<CFG_rule, uint32_t>);
+  } else if (algorithm == "LSM") {
+    stabber.reset(new LsmNestedIntervalStabber<CFG_rule, uint32_t>);
+  } else if (algorithm == "FAST") {
+    stabber.reset(new FastNestedIntervalStabber<CFG_rule, uint32_t>);
+  } else {  // "CONCURRENT"
+    stabber.reset(new ConcurrentNestedIntervalStabber<CFG_rule, uint32_t>);
+  }
+
+  // publish each depth, as csaToCfg publishes the intervals of each LCP value;
+  // publishing is a no-op for every algorithm but CONCURRENT
+  auto start = chrono::high_resolution_clock::now();
+  for (size_t k = 0; k < intervals.size(); ++k) {
+    if (k > 0 && intervals[k].depth != intervals[k-1].depth) {
+      stabber->publish();
+    }
+    stabber->update(intervals[k].begin, intervals[k].end, CFG_rule{k, 1});
+  }
+  stabber->publish();
+  measurement.update_ns = elapsed(start) / intervals.size();
+  measurement.interval_bytes =
+    double(peak_bytes - allocated) / intervals.size();
+
+  uint64_t hits = 0;
+  start = chrono::high_resolution_clock::now();
+  for (const uint32_t& q: queries) {
+    hits += stabber->stab(q) != NULL;
+  }
+  measurement.stab_ns = elapsed(start) / queries.size();
+
+  vector<uint32_t> positions;
+  vector<const CFG_rule*> ids;
+  start = chrono::high_resolution_clock::now();
+  stabber->boundaries(positions, ids);
+  measurement.boundary_ns =
+    elapsed(start) / max<size_t>(1, positions.size());
+
+  sink = hits;
+  return measurement;
+}
+
+
+//! Rounds a cost to a tenth of a nanosecond.
+double tenths(double ns) {
+  return round(10 * ns) / 10;
+}
+
+
+//! Prints an array of costs in the form they're declared in cost.hpp.
+void printCosts(const double (&costs)[5]) {
+  cout << "  {";
+  for (int k = 0; k < 5; ++k) {
+    cout << (k > 0 ? ", " : "") << round(costs[k]);
+  }
+  cout << "}," << endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+
+  // check the command-line arguments
+  const uint64_t num_queries = argc > 1 ? stoull(argv[1]) : 2097152;
+  const uint64_t repetitions = argc > 2 ? stoull(argv[2]) : 2;
+  const uint64_t seed = argc > 3 ? stoull(argv[3]) : 0;
+  if (argc > 4 || num_queries == 0 || repetitions == 0) {
+    usage(argv);
+    return 1;
+  }
+
+  // the fastest of the repetitions of each measurement and the most memory
+  // per interval of any family
+  const vector<string> algorithms = {"ONLINE", "LSM", "CONCURRENT", "FAST"};
+  vector<StabberCalibration> calibrations(algorithms.size());
+  double fast_update_ns[5];
+  double num_intervals[5];
+  for (int d = 0; d < 5; ++d) {
+    mt19937_64 rng(seed);
+    const vector<LaminarInterval> intervals =
+      generateLaminarFamily(N, DEPTHS[d], rng);
+    num_intervals[d] = intervals.size();
+    vector<uint32_t> queries(num_queries);
+    uniform_int_distribution<uint32_t> position(0, N-1);
+    for (uint32_t& q: queries) {
+      q = position(rng);
+    }
+    for (size_t a = 0; a < algorithms.size(); ++a) {
+      StabberCalibration& c = calibrations[a];
+      c.stab_ns[d] = c.update_ns[d] = c.boundary_ns[d] =
+        numeric_limits<double>::max();
+      for (uint64_t r = 0; r < repetitions; ++r) {
+        const Measurement m = measure(algorithms[a], intervals, queries);
+        c.stab_ns[d] = min(c.stab_ns[d], m.stab_ns);
+        c.update_ns[d] = min(c.update_ns[d], m.update_ns);
+        c.boundary_ns[d] = min(c.boundary_ns[d], m.boundary_ns);
+        c.interval_bytes = max(c.interval_bytes, m.interval_bytes);
+      }
+    }
+    fast_update_ns[d] = calibrations.back().update_ns[d];
+  }
+
+  // FAST's update cost is modeled as a cost per boundary plus the cost of
+  // moving half of the existing chunks whenever a chunk is created; the two
+  // are fit to its measured update times by least squares
+  const double max_chunks = N / FAST_CHUNK_POSITIONS;
+  double bb = 0, bc = 0, cc = 0, bt = 0, ct = 0;
+  for (int d = 0; d < 5; ++d) {
+    const double boundaries = 2 * num_intervals[d];
+    const double chunks = max_chunks * (1 - exp(-boundaries / max_chunks));
+    const double moves = chunks * chunks / 2;
+    const double ns = fast_update_ns[d] * num_intervals[d];
+    bb += boundaries * boundaries;
+    bc += boundaries * moves;
+    cc += moves * moves;
+    bt += boundaries * ns;
+    ct += moves * ns;
+  }
+  const double position_ns = (bt*cc - ct*bc) / (bb*cc - bc*bc);
+  const double chunk_move_ns = (ct*bb - bt*bc) / (bb*cc - bc*bc);
+  StabberCalibration& fast = calibrations.back();
+  for (int d = 0; d < 5; ++d) {
+    fast.update_ns[d] = 0;
+  }
+  fast.interval_bytes = 0;
+
+  // SuccessorBitVector insertions and successor queries, as OPTIMAL makes,
+  // over as many bits as the largest family has intervals
+  const uint64_t m = num_intervals[4];
+  mt19937_64 rng(seed);
+  vector<uint64_t> bits(m);
+  for (uint64_t k = 0; k < m; ++k) {
+    bits[k] = k;
+  }
+  shuffle(bits.begin(), bits.end(), rng);
+  SuccessorBitVector successors(m);
+  auto start = chrono::high_resolution_clock::now();
+  for (uint64_t k = 0; k < m / 2; ++k) {
+    successors.add(bits[k]);
+  }
+  const double successor_add_ns = elapsed(start) / (m / 2);
+  uint64_t found = 0;
+  uint64_t bit = 0;
+  start = chrono::high_resolution_clock::now();
+  for (uint64_t k = 0; k < num_queries; ++k) {
+    // each query depends on the last so they can't be overlapped
+    found += successors.next(bits[(k + found) % m], bit) ? bit & 1 : 0;
+  }
+  const double successor_ns = elapsed(start) / num_queries;
+  sink = found;
+
+  // the latency of dependent loads in a random cycle through each size
+  double latency_ns[4];
+  for (int k = 0; k < 4; ++k) {
+    const uint64_t words = LATENCY_BYTES[k] / sizeof(uint64_t);
+    // Sattolo's algorithm gives a single cycle through every word
+    vector<uint64_t> next(words);
+    for (uint64_t w = 0; w < words; ++w) {
+      next[w] = w;
+    }
+    for (uint64_t w = words - 1; w > 0; --w) {
+      uniform_int_distribution<uint64_t> other(0, w - 1);
+      swap(next[w], next[other(rng)]);
+    }
+    uint64_t w = 0;
+    start = chrono::high_resolution_clock::now();
+    for (uint64_t q = 0; q < num_queries; ++q) {
+      w = next[w];
+    }
+    latency_ns[k] = elapsed(start) / num_queries;
+    sink = w;
+  }
+
+  // a sequential scan of N bits that computes the rank of every position,
+  // with a rank sample every 512 bits, as OPTIMAL's preprocessing does
+  vector<uint64_t> words(N / 64);
+  for (uint64_t& word: words) {
+    word = rng() & rng() & rng();
+  }
+  vector<uint64_t> samples(words.size() / 8 + 1);
+  for (uint64_t w = 0, rank = 0; w < words.size(); ++w) {
+    if (w % 8 == 0) {
+      samples[w / 8] = rank;
+    }
+    rank += popcount(words[w]);
+  }
+  uint64_t ranks = 0;
+  start = chrono::high_resolution_clock::now();
+  for (uint64_t i = 0; i < N; ++i) {
+    const uint64_t w = i / 64;
+    uint64_t rank = samples[w / 8];
+    for (uint64_t v = w - w % 8; v < w; ++v) {
+      rank += popcount(words[v]);
+    }
+    ranks += rank + popcount(words[w] & ((uint64_t(1) << (i % 64)) - 1));
+  }
+  const double sequential_ns = elapsed(start) / N;
+  sink = ranks;
+
+  // print the constants in the form they're declared in cost.hpp
+  cout << "// measured with MR-CFG-bench-calibrate " << num_queries << " "
+       << repetitions << " " << seed << endl;
+  for (size_t a = 0; a < algorithms.size(); ++a) {
+    const StabberCalibration& c = calibrations[a];
+    cout << "const StabberCalibration " << algorithms[a] << "_CALIBRATION{"
+         << endl;
+    printCosts(c.stab_ns);
+    printCosts(c.update_ns);
+    printCosts(c.boundary_ns);
+    cout << "  " << round(c.interval_bytes) << "};" << endl;
+  }
+  cout << "const double FAST_POSITION_NS = " << round(position_ns) << ";"
+       << endl;
+  cout << "const double FAST_CHUNK_MOVE_NS = " << tenths(chunk_move_ns) << ";"
+       << endl;
+  cout << "const double LATENCY_NS[4] = {";
+  for (int k = 0; k < 4; ++k) {
+    cout << (k > 0 ? ", " : "") << tenths(latency_ns[k]);
+  }
+  cout << "};" << endl;
+  cout << "const double SEQUENTIAL_NS = " << tenths(sequential_ns) << ";"
+       << endl;
+  cout << "const double SUCCESSOR_NS = " << tenths(successor_ns) << ";"
+       << endl;
+  cout << "const double SUCCESSOR_ADD_NS = " << tenths(successor_add_ns) << ";"
+       << endl;
+
+  return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>  // min
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>  // invalid_argument
+#include <string>
+#include <vector>
+
+#include <sdsl/int_vector.hpp>
+
+#include "mr-cfg/cfg.hpp"
+#include "mr-cfg/csa.hpp"
+#include "mr-cfg/file.hpp"
+
+using namespace std;
+using namespace sdsl;
+using namespace mr_cfg;
+
+
+// the most SA and ISA values accessed per configuration
+const uint64_t MAX_ACCESSES = 1000000;
+
+
+void usage(char* argv[]) {
+  cerr << "Usage: " << argv[0] << " {OPTIMAL|ONLINE|FAST|LSM} <FILE>..." << endl;
+}
+
+
+//! Returns the milliseconds elapsed since the given time.
+double elapsed(const chrono::high_resolution_clock::time_point& start) {
+  chrono::duration<double, milli> duration =
+    chrono::high_resolution_clock::now() - start;
+  return duration.count();
+}
+
+
+//! The costs of a CSA configuration and the grammar built with it.
+struct Result
+{
+  double sa_ns = 0;
+  double isa_ns = 0;
+  double enumeration_ms = 0;
+  double cfg_ms = 0;
+  uint64_t queue_bytes = 0;
+  uint64_t total_size = 0;
+};
+
+
+//! Measures the operations grammar construction uses with a CSA: random SA
+//  accesses, sequential ISA accesses, LCP-interval enumeration, and the
+//  construction itself.
+template <class csa_type>
+Result benchmark(const csa_type& csa, const string& algorithm) {
+  Result result;
+  const uint64_t n = csa.size();
+  const uint64_t accesses = min(n, MAX_ACCESSES);
+
+  // random SA accesses
+  mt19937_64 rng(0);
+  uniform_int_distribution<uint64_t> position(0, n-1);
+  vector<uint64_t> positions(accesses);
+  for (uint64_t& i: positions) {
+    i = position(rng);
+  }
+  uint64_t checksum = 0;
+  auto start = chrono::high_resolution_clock::now();
+  for (const uint64_t& i: positions) {
+    checksum += csa[i];
+  }
+  result.sa_ns = 1000000 * elapsed(start) / accesses;
+
+  // sequential ISA accesses, as in computeProduction
+  start = chrono::high_resolution_clock::now();
+  for (uint64_t i = 0; i < accesses; ++i) {
+    checksum += csa.isa[i];
+  }
+  result.isa_ns = 1000000 * elapsed(start) / accesses;
+
+  // LCP-interval enumeration
+  start = chrono::high_resolution_clock::now();
+  for_each_lcp_interval(csa, [&](const auto& interval) {
+    checksum += interval.left_extensions;
+  });
+  result.enumeration_ms = elapsed(start);
+
+  // grammar construction
+  LcpIntervalStatistics lcp_statistics;
+  start = chrono::high_resolution_clock::now();
+  auto [cfg, start_rule] = csaToCfg(csa, algorithm, 1, &lcp_statistics);
+  result.cfg_ms = elapsed(start);
+  result.queue_bytes = lcp_statistics.peak_queue_bytes;
+  result.total_size = csa.sigma;
+  for (const auto& [rule, production] : cfg) {
+    result.total_size += production.size();
+  }
+
+  // keep the accesses from being optimized away
+  if (checksum == numeric_limits<uint64_t>::max()) {
+    cerr << checksum << endl;
+  }
+  return result;
+}
+
+
+int main(int argc, char* argv[])
+{
+
+  // check the command-line arguments
+  if (argc < 3) {
+    usage(argv);
+    return 1;
+  }
+  const string algorithm = argv[1];
+  if (algorithm != "OPTIMAL" && algorithm != "ONLINE" &&
+      algorithm != "FAST" && algorithm != "LSM")
+  {
+    usage(argv);
+    return 1;
+  }
+
+  cout << "file\tconfiguration\tbuild (ms)\tcsa (bytes)\tSA (ns)\tISA (ns)"
+       << "\tenumeration (ms)\tCFG (ms)\tqueue (bytes)\tCFG size" << endl;
+  for (int f = 2; f < argc; ++f) {
+    int_vector<8> text = load_text(argv[f]);
+    uint64_t expected_size = 0;
+    for (const string& configuration: csaConfigurations()) {
+      // skip configurations that don't support the text, e.g. PACKED
+      try {
+        auto start = chrono::high_resolution_clock::now();
+        withCsa(configuration, text, [&](const auto& csa) {
+          const double build_ms = elapsed(start);
+          const Result result = benchmark(csa, algorithm);
+          if (expected_size == 0) {
+            expected_size = result.total_size;
+          } else if (result.total_size != expected_size) {
+            cerr << configuration << ": CFG size differs from "
+                 << csaConfigurations().front() << endl;
+          }
+          cout << argv[f] << "\t" << configuration << "\t" << build_ms << "\t"
+               << csaSizeInBytes(csa) << "\t" << result.sa_ns << "\t"
+               << result.isa_ns << "\t" << result.enumeration_ms << "\t"
+               << result.cfg_ms << "\t" << result.queue_bytes << "\t"
+               << result.total_size << endl;
+        });
+      } catch (const invalid_argument& e) {
+        cerr << configuration << ": " << e.what() << endl;
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>  // min
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sdsl/construct.hpp>
+#include <sdsl/csa_wt.hpp>
+
+#include "mr-cfg/file.hpp"
+#include "mr-cfg/lcp.hpp"
+
+using namespace std;
+using namespace sdsl;
+using namespace mr_cfg;
+
+
+typedef csa_wt<wt_huff<>> csa_type;
+typedef csa_type::size_type size_type;
+
+
+//! What a consumer computes from the LCP-intervals; every enumeration path
+//  should compute the same summary.
+struct Summary
+{
+  uint64_t intervals = 0;
+  uint64_t maximal = 0;
+  uint64_t width = 0;
+
+  //! Adds an LCP-interval to the summary.
+  void add(size_type begin, size_type end, size_type left_extensions) {
+    intervals += 1;
+    if (left_extensions > 1) {
+      maximal += 1;
+      width += end - begin + 1;
+    }
+  }
+
+  bool operator==(const Summary& other) const = default;
+};
+
+
+void usage(char* argv[]) {
+  cerr << "Usage: " << argv[0] << " <FILE> [REPETITIONS]" << endl;
+}
+
+
+//! Returns the milliseconds elapsed since the given time.
+double elapsed(const chrono::high_resolution_clock::time_point& start) {
+  chrono::duration<double, milli> duration =
+    chrono::high_resolution_clock::now() - start;
+  return duration.count();
+}
+
+
+//! Enumerates the LCP-intervals with a coroutine that yields one at a time.
+Summary enumerateGenerator(const csa_type& csa) {
+  Summary summary;
+  vector<size_type> interval;  // {LCP-value, begin, end}
+  bool loc_max;
+  for (auto left_extensions: lcp_interval_generator(csa, interval, loc_max)) {
+    summary.add(interval[1], interval[2], *left_extensions);
+  }
+  return summary;
+}
+
+
+//! Enumerates the LCP-intervals with a coroutine that yields one LCP value's
+//  intervals at a time.
+Summary enumerateBatchGenerator(const csa_type& csa) {
+  Summary summary;
+  for (auto batch: lcp_interval_batch_generator(csa)) {
+    for (const LcpInterval<size_type>& interval: *batch) {
+      summary.add(interval.begin, interval.end, interval.left_extensions);
+    }
+  }
+  return summary;
+}
+
+
+//! Enumerates the LCP-intervals with a visitor.
+Summary enumerateForEach(const csa_type& csa) {
+  Summary summary;
+  for_each_lcp_interval(csa, [&](const LcpInterval<size_type>& interval) {
+    summary.add(interval.begin, interval.end, interval.left_extensions);
+  });
+  return summary;
+}
+
+
+int main(int argc, char* argv[])
+{
+
+  // check the command-line arguments
+  if (argc < 2) {
+    usage(argv);
+    return 1;
+  }
+  const uint64_t repetitions = argc > 2 ? stoull(argv[2]) : 3;
+  if (repetitions == 0) {
+    usage(argv);
+    return 1;
+  }
+
+  // construct the Compressed Suffix Array
+  int_vector<8> text = load_text(argv[1]);
+  csa_type csa;
+  construct_im(csa, text);
+
+  // enumerate the LCP-intervals with each path, keeping the fastest run
+  cout << "path\tintervals\tmaximal\ttime (ms)\tintervals/ms" << endl;
+  Summary expected;
+  for (const string path: {"GENERATOR", "BATCH_GENERATOR", "FOR_EACH"}) {
+    Summary summary;
+    double best_ms = 0;
+    for (uint64_t r = 0; r < repetitions; ++r) {
+      auto start = chrono::high_resolution_clock::now();
+      if (path == "GENERATOR") {
+        summary = enumerateGenerator(csa);
+      } else if (path == "BATCH_GENERATOR") {
+        summary = enumerateBatchGenerator(csa);
+      } else {  // "FOR_EACH"
+        summary = enumerateForEach(csa);
+      }
+      const double ms = elapsed(start);
+      best_ms = r == 0 ? ms : min(best_ms, ms);
+    }
+    if (path == "GENERATOR") {
+      expected = summary;
+    } else if (summary != expected) {
+      cerr << path << ": LCP-intervals differ from GENERATOR" << endl;
+    }
+    cout << path << "\t" << summary.intervals << "\t" << summary.maximal << "\t"
+         << best_ms << "\t" << summary.intervals / best_ms << endl;
+  }
+
+  return 0;
+}
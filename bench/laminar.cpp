@@ -0,0 +1,349 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>  // max, min, sort
+#include <chrono>
+#include <cstddef>  // size_t
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sdsl/csa_wt.hpp>
+
+#include "mr-cfg/cfg.hpp"
+#include "mr-cfg/interval.hpp"
+#include "mr-cfg/record.hpp"
+
+using namespace std;
+using namespace sdsl;
+using namespace mr_cfg;
+
+
+// the OPTIMAL data-structure is parameterized by the CSA its record is from
+typedef csa_wt<wt_huff<>> csa_type;
+
+
+// the number of heap allocations made so far; with glibc, malloc is
+// interposed so allocations made by C libraries and by sdsl are counted
+// along with operator new's
+uint64_t num_allocations = 0;
+
+#ifdef __GLIBC__
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+
+void* malloc(size_t size) noexcept {
+  num_allocations += 1;
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept {
+  num_allocations += 1;
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) noexcept {
+  num_allocations += 1;
+  return __libc_realloc(pointer, size);
+}
+}
+#endif
+
+
+//! An interval of a laminar family.
+struct LaminarInterval
+{
+  uint64_t begin;
+  uint64_t end;
+  uint64_t depth;
+};
+
+
+//! The parameters of a random laminar family.
+struct LaminarParameters
+{
+  // the number of positions the intervals are in
+  uint64_t n;
+  // the depth of the deepest intervals; top-level intervals have depth 1
+  uint64_t depth;
+  // the number of children of each interval
+  uint64_t fanout;
+  // UNIFORM gives siblings similar widths; SKEWED gives each interval one
+  // child that's much wider than its siblings, i.e. a heavy path
+  string widths;
+  // LEVEL updates intervals shortest-first, i.e. by depth as in csaToCfg;
+  // PREORDER updates them in order of begin position
+  string order;
+};
+
+
+void usage(char* argv[]) {
+  cerr << "Usage: " << argv[0]
+       << " <N> <MAX_DEPTH> <FANOUT> {UNIFORM|SKEWED} {LEVEL|PREORDER}"
+       << " [QUERIES] [SEED]" << endl;
+}
+
+
+//! Returns the milliseconds elapsed since the given time.
+double elapsed(const chrono::high_resolution_clock::time_point& start) {
+  chrono::duration<double, milli> duration =
+    chrono::high_resolution_clock::now() - start;
+  return duration.count();
+}
+
+
+//! Generates a random laminar family of intervals in [0, n-1), i.e. intervals
+//  that are either disjoint or nested and never equal. Like LCP-intervals,
+//  every interval contains at least two positions. Every interval precedes the
+//  intervals nested in it, as the stabbing data-structures require.
+vector<LaminarInterval>
+generateLaminarFamily(const LaminarParameters& p, mt19937_64& rng) {
+  vector<LaminarInterval> intervals;
+  // the virtual root spans every position and isn't itself an interval
+  queue<LaminarInterval> parents;
+  parents.push({0, p.n-2, 0});
+  while (!parents.empty()) {
+    const LaminarInterval parent = parents.front();
+    parents.pop();
+    if (parent.depth == p.depth) {
+      continue;
+    }
+    // children must be narrower than their parent, except at the top level
+    const bool is_root = parent.depth == 0;
+    uint64_t width = parent.end - parent.begin + (is_root ? 1 : 0);
+    if (width < 2*p.fanout) {
+      continue;
+    }
+    // children shrink slowly enough that chains can reach the max depth
+    const uint64_t levels = p.depth - parent.depth;
+    uint64_t slot_begin = parent.begin;
+    for (uint64_t c = 0; c < p.fanout; ++c) {
+      // divide the remaining width into slots, one per child
+      const uint64_t remaining = p.fanout - c;
+      uint64_t slot_width;
+      if (p.widths == "SKEWED" && remaining > 1) {
+        // leave at least two positions for each of the remaining siblings
+        slot_width = min(width / 2, width - 2*(remaining - 1));
+      } else {
+        slot_width = width / remaining;
+      }
+      width -= slot_width;
+      // place a child of random width in the slot
+      uniform_int_distribution<uint64_t> child_width(
+        max<uint64_t>(2, slot_width - slot_width / (levels + 1)), slot_width);
+      const uint64_t w = child_width(rng);
+      uniform_int_distribution<uint64_t> offset(0, slot_width - w);
+      const uint64_t begin = slot_begin + offset(rng);
+      const LaminarInterval child{begin, begin + w - 1, parent.depth + 1};
+      intervals.push_back(child);
+      parents.push(child);
+      slot_begin += slot_width;
+    }
+  }
+  // intervals are generated level by level; a preorder puts each interval
+  // before the intervals that begin after it and those nested in it
+  if (p.order == "PREORDER") {
+    sort(intervals.begin(), intervals.end(),
+      [](const LaminarInterval& a, const LaminarInterval& b) {
+        return a.begin < b.begin || (a.begin == b.begin && a.end > b.end);
+      });
+  }
+  return intervals;
+}
+
+
+//! Copies the results of stabbing queries so they outlive the data-structure;
+//  NULL results become the max rule.
+vector<CFG_rule> toValues(const vector<const CFG_rule*>& results) {
+  vector<CFG_rule> values(results.size(), numeric_limits<CFG_rule>::max());
+  for (size_t k = 0; k < results.size(); ++k) {
+    if (results[k] != NULL) {
+      values[k] = *results[k];
+    }
+  }
+  return values;
+}
+
+
+//! Builds a data-structure with each algorithm, updates it with every interval
+//  of the family in order, stabs it one query at a time and with stabMany,
+//  and then gets its boundaries. The intervals' IDs are CFG rules, as when
+//  building a grammar. Results are checked against the ONLINE
+//  data-structure's.
+template <typename position_type>
+void benchmark(
+  const LaminarParameters& p,
+  const vector<LaminarInterval>& intervals,
+  const vector<position_type>& queries)
+{
+  vector<CFG_rule> expected;
+  for (const string algorithm:
+       {"ONLINE", "OPTIMAL", "LSM", "FAST", "CONCURRENT", "FROZEN"})
+  {
+    // build the data-structure; OPTIMAL and FROZEN do their work here
+    uint64_t allocations = num_allocations;
+    auto start = chrono::high_resolution_clock::now();
+    unique_ptr<NestedIntervalStabber<CFG_rule, position_type>> stabber;
+    unique_ptr<ConcurrentNestedIntervalStabber<CFG_rule, position_type>> concurrent;
+    if (algorithm == "OPTIMAL") {
+      MaximalIntervalRecord<csa_type> record(p.n, max<uint64_t>(p.n, intervals.size()));
+      for (size_t k = 0; k < intervals.size(); ++k) {
+        record.push_back(intervals[k].begin, intervals[k].end, k, 1, 0);
+      }
+      stabber.reset(
+        new OptimalNestedIntervalStabber<CFG_rule, csa_type, position_type>(record));
+    } else if (algorithm == "ONLINE") {
+      stabber.reset(new OnlineNestedIntervalStabber<CFG_rule, position_type>);
+    } else if (algorithm == "LSM") {
+      stabber.reset(new LsmNestedIntervalStabber<CFG_rule, position_type>);
+    } else if (algorithm == "CONCURRENT") {
+      concurrent.reset(new ConcurrentNestedIntervalStabber<CFG_rule, position_type>);
+    } else {  // "FAST" and "FROZEN"
+      stabber.reset(new FastNestedIntervalStabber<CFG_rule, position_type>);
+    }
+    NestedIntervalStabber<CFG_rule, position_type>& target =
+      concurrent ? *concurrent : *stabber;
+    double build_ms = elapsed(start);
+    uint64_t build_allocations = num_allocations - allocations;
+
+    // update every interval in order
+    allocations = num_allocations;
+    start = chrono::high_resolution_clock::now();
+    for (size_t k = 0; k < intervals.size(); ++k) {
+      // publish each depth of a LEVEL family, as csaToCfg publishes the
+      // intervals of each LCP value
+      if (concurrent && p.order == "LEVEL" && k > 0 &&
+          intervals[k].depth != intervals[k-1].depth)
+      {
+        concurrent->publish();
+      }
+      target.update(intervals[k].begin, intervals[k].end, CFG_rule{k, 1});
+    }
+    if (concurrent) {
+      concurrent->publish();
+    }
+    double update_ms = elapsed(start);
+    const uint64_t update_allocations = num_allocations - allocations;
+
+    // freeze the updated FAST data-structure
+    NestedIntervalStabber<CFG_rule, position_type>* queried = &target;
+    unique_ptr<FrozenNestedIntervalStabber<CFG_rule, position_type>> frozen;
+    if (algorithm == "FROZEN") {
+      allocations = num_allocations;
+      start = chrono::high_resolution_clock::now();
+      frozen.reset(new FrozenNestedIntervalStabber<CFG_rule, position_type>(target));
+      build_ms += elapsed(start);
+      build_allocations += num_allocations - allocations;
+      queried = frozen.get();
+    }
+
+    // stab one query at a time and then in batches
+    vector<const CFG_rule*> single(queries.size());
+    start = chrono::high_resolution_clock::now();
+    for (size_t k = 0; k < queries.size(); ++k) {
+      single[k] = queried->stab(queries[k]);
+    }
+    double single_ms = elapsed(start);
+    vector<const CFG_rule*> batched;
+    start = chrono::high_resolution_clock::now();
+    queried->stabMany(queries, batched);
+    double batched_ms = elapsed(start);
+
+    // get the boundaries, as when the data-structure is frozen
+    vector<position_type> positions;
+    vector<const CFG_rule*> ids;
+    start = chrono::high_resolution_clock::now();
+    queried->boundaries(positions, ids);
+    double boundaries_ms = elapsed(start);
+
+    vector<CFG_rule> values = toValues(single);
+    if (algorithm == "ONLINE") {
+      expected = values;
+    } else if (values != expected) {
+      cerr << algorithm << ": results differ from ONLINE" << endl;
+    }
+    if (single != batched) {
+      cerr << algorithm << ": stabMany results differ from stab" << endl;
+    }
+    cout << p.depth << "\t" << intervals.size() << "\t" << algorithm << "\t"
+         << build_ms << "\t" << build_allocations << "\t" << update_ms << "\t"
+         << update_allocations << "\t" << single_ms << "\t" << batched_ms << "\t"
+         << queries.size() / single_ms << "\t" << positions.size() << "\t"
+         << boundaries_ms << endl;
+  }
+}
+
+
+int main(int argc, char* argv[])
+{
+
+  // check the command-line arguments
+  if (argc < 6) {
+    usage(argv);
+    return 1;
+  }
+  LaminarParameters p;
+  p.n = stoull(argv[1]);
+  const uint64_t max_depth = stoull(argv[2]);
+  p.fanout = stoull(argv[3]);
+  p.widths = argv[4];
+  p.order = argv[5];
+  const uint64_t num_queries = argc > 6 ? stoull(argv[6]) : 1000000;
+  const uint64_t seed = argc > 7 ? stoull(argv[7]) : 0;
+  if (p.n < 2 || p.fanout == 0 ||
+      (p.widths != "UNIFORM" && p.widths != "SKEWED") ||
+      (p.order != "LEVEL" && p.order != "PREORDER"))
+  {
+    usage(argv);
+    return 1;
+  }
+
+  // benchmark families of doubling depth up to the max depth
+  cout << "depth\tintervals\talgorithm\tbuild (ms)\tbuild allocations"
+       << "\tupdate (ms)\tupdate allocations\tstab (ms)\tstabMany (ms)"
+       << "\tstab (queries/ms)\tboundaries\tboundaries (ms)" << endl;
+  for (uint64_t depth = 1; ; depth = min(2*depth, max_depth)) {
+    p.depth = depth;
+    mt19937_64 rng(seed);
+    vector<LaminarInterval> intervals = generateLaminarFamily(p, rng);
+    uniform_int_distribution<uint64_t> position(0, p.n-1);
+    if (p.n <= numeric_limits<uint32_t>::max()) {
+      vector<uint32_t> queries(num_queries);
+      for (uint32_t& q: queries) {
+        q = position(rng);
+      }
+      benchmark<uint32_t>(p, intervals, queries);
+    } else {
+      vector<uint64_t> queries(num_queries);
+      for (uint64_t& q: queries) {
+        q = position(rng);
+      }
+      benchmark<uint64_t>(p, intervals, queries);
+    }
+    if (depth == max_depth) {
+      break;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,270 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>  // min
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include <sdsl/construct.hpp>
+#include <sdsl/csa_wt.hpp>
+
+#include "mr-cfg/cfg.hpp"
+#include "mr-cfg/file.hpp"
+#include "mr-cfg/interval.hpp"
+
+using namespace std;
+using namespace sdsl;
+using namespace mr_cfg;
+
+
+// the number of updates the concurrent writer makes between publishes
+const size_t PUBLISH_INTERVAL = 1024;
+
+
+//! An update made during a construction run.
+template <typename position_type>
+struct Update
+{
+  position_type begin;
+  position_type end;
+  CFG_rule id;
+};
+
+
+//! Wraps an interval stabbing data-structure and records the points it's
+//  queried with and the intervals it's updated with, i.e. the query and
+//  update streams of a construction run.
+template <typename position_type>
+class RecordingNestedIntervalStabber:
+  public NestedIntervalStabber<CFG_rule, position_type>
+{
+
+private:
+
+  NestedIntervalStabber<CFG_rule, position_type>& _intervals;
+
+public:
+
+  vector<position_type> queries;
+  vector<Update<position_type>> updates;
+
+  RecordingNestedIntervalStabber(
+    NestedIntervalStabber<CFG_rule, position_type>& intervals):
+    _intervals(intervals) { }
+
+  const CFG_rule* stab(const position_type& i) {
+    queries.push_back(i);
+    return _intervals.stab(i);
+  }
+
+  void update(const position_type& begin, const position_type& end, const CFG_rule& id) {
+    updates.push_back({begin, end, id});
+    _intervals.update(begin, end, id);
+  }
+
+  void boundaries(
+    vector<position_type>& positions,
+    vector<const CFG_rule*>& ids) const
+  {
+    _intervals.boundaries(positions, ids);
+  }
+
+};
+
+
+void usage(char* argv[]) {
+  cerr << "Usage: " << argv[0] << " <FILE>" << endl;
+}
+
+
+//! Returns the milliseconds elapsed since the given time.
+double elapsed(const chrono::high_resolution_clock::time_point& start) {
+  chrono::duration<double, milli> duration =
+    chrono::high_resolution_clock::now() - start;
+  return duration.count();
+}
+
+
+//! Copies the results of stabbing queries so they outlive the data-structure;
+//  NULL results become the max ID.
+vector<CFG_rule> toValues(const vector<const CFG_rule*>& results) {
+  vector<CFG_rule> values(results.size(), numeric_limits<CFG_rule>::max());
+  for (size_t k = 0; k < results.size(); ++k) {
+    if (results[k] != NULL) {
+      values[k] = *results[k];
+    }
+  }
+  return values;
+}
+
+
+//! Has each of the given number of threads stab every query and returns the
+//  combined throughput in queries per millisecond.
+template <typename position_type>
+double stabConcurrently(
+  ConcurrentNestedIntervalStabber<CFG_rule, position_type>& intervals,
+  const vector<position_type>& queries,
+  unsigned num_threads)
+{
+  atomic<size_t> hits = 0;
+  vector<thread> readers;
+  auto start = chrono::high_resolution_clock::now();
+  for (unsigned t = 0; t < num_threads; ++t) {
+    readers.emplace_back([&]() {
+      size_t thread_hits = 0;
+      for (const position_type& i: queries) {
+        thread_hits += intervals.stab(i) != NULL;
+      }
+      hits += thread_hits;
+    });
+  }
+  for (thread& reader: readers) {
+    reader.join();
+  }
+  return (num_threads * queries.size()) / elapsed(start);
+}
+
+
+//! Measures how the concurrent data-structure's stabbing throughput scales
+//  with the number of readers, both after all the updates have been published
+//  and while a writer replays and publishes the updates.
+template <typename position_type>
+void benchmarkConcurrency(
+  const vector<position_type>& queries,
+  const vector<Update<position_type>>& updates,
+  const vector<CFG_rule>& expected)
+{
+  // check the concurrent data-structure against the single-threaded results
+  ConcurrentNestedIntervalStabber<CFG_rule, position_type> published;
+  for (const Update<position_type>& u: updates) {
+    published.update(u.begin, u.end, u.id);
+  }
+  published.publish();
+  vector<const CFG_rule*> results;
+  published.stabMany(queries, results);
+  if (toValues(results) != expected) {
+    cerr << "CONCURRENT: results differ from FAST" << endl;
+  }
+
+  cout << "readers\tpublished (queries/ms)\twith writer (queries/ms)" << endl;
+  const unsigned max_threads = max(1u, thread::hardware_concurrency());
+  for (unsigned num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+    double published_throughput =
+      stabConcurrently(published, queries, num_threads);
+    // replay the updates in a writer thread while the readers stab
+    ConcurrentNestedIntervalStabber<CFG_rule, position_type> intervals;
+    thread writer([&]() {
+      for (size_t k = 0; k < updates.size(); ++k) {
+        intervals.update(updates[k].begin, updates[k].end, updates[k].id);
+        if ((k+1) % PUBLISH_INTERVAL == 0) {
+          intervals.publish();
+        }
+      }
+      intervals.publish();
+    });
+    double writer_throughput =
+      stabConcurrently(intervals, queries, num_threads);
+    writer.join();
+    cout << num_threads << "\t" << published_throughput << "\t"
+         << writer_throughput << endl;
+  }
+}
+
+
+//! Records the stabbing queries of a construction run with each algorithm and
+//  replays them against the final data-structure, first one query at a time,
+//  then with stabMany, and then against a frozen copy. The FAST run's queries
+//  and updates are then used to benchmark the concurrent data-structure.
+template <typename position_type, class csa_wt>
+void benchmark(const csa_wt& csa) {
+  vector<position_type> queries;
+  vector<Update<position_type>> updates;
+  vector<CFG_rule> expected;
+  cout << "algorithm\tqueries\tstab (ms)\tstabMany (ms)\tfrozen stab (ms)\tstab (queries/ms)" << endl;
+  for (const string algorithm: {"OPTIMAL", "ONLINE", "LSM", "FAST"}) {
+    auto intervals =
+      makeNestedIntervalStabber<CFG_rule, position_type>(algorithm, csa);
+    RecordingNestedIntervalStabber<position_type> recorder(*intervals);
+    csaToCfg(csa, recorder);
+    queries = recorder.queries;
+    updates = recorder.updates;
+
+    // replay the queries one at a time
+    vector<const CFG_rule*> single(queries.size());
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t k = 0; k < queries.size(); ++k) {
+      single[k] = intervals->stab(queries[k]);
+    }
+    double single_ms = elapsed(start);
+
+    // replay the queries in batches
+    vector<const CFG_rule*> batched;
+    start = chrono::high_resolution_clock::now();
+    intervals->stabMany(queries, batched);
+    double batched_ms = elapsed(start);
+
+    // replay the queries one at a time against a frozen copy
+    FrozenNestedIntervalStabber<CFG_rule, position_type> frozen(*intervals);
+    vector<const CFG_rule*> frozen_results(queries.size());
+    start = chrono::high_resolution_clock::now();
+    for (size_t k = 0; k < queries.size(); ++k) {
+      frozen_results[k] = frozen.stab(queries[k]);
+    }
+    double frozen_ms = elapsed(start);
+
+    if (single != batched) {
+      cerr << algorithm << ": stabMany results differ from stab" << endl;
+    }
+    if (toValues(single) != toValues(frozen_results)) {
+      cerr << algorithm << ": frozen results differ from stab" << endl;
+    }
+    cout << algorithm << "\t" << queries.size() << "\t" << single_ms << "\t"
+         << batched_ms << "\t" << frozen_ms << "\t"
+         << queries.size() / single_ms << endl;
+    expected = toValues(single);
+  }
+  cout << endl;
+  benchmarkConcurrency(queries, updates, expected);
+}
+
+
+int main(int argc, char* argv[])
+{
+
+  // check the command-line arguments
+  if (argc < 2) {
+    usage(argv);
+    return 1;
+  }
+
+  // construct the Compressed Suffix Array
+  int_vector<8> text = load_text(argv[1]);
+  csa_wt<wt_huff<>> csa;
+  construct_im(csa, text);
+
+  if (csa.size() <= numeric_limits<uint32_t>::max()) {
+    benchmark<uint32_t>(csa);
+  } else {
+    benchmark<uint64_t>(csa);
+  }
+
+  return 0;
+}
@@ -17,13 +17,24 @@
 #ifndef INCLUDED_MR_CFG_CFG
 #define INCLUDED_MR_CFG_CFG
 
+#include <cstdint>
+#include <functional>  // hash
+#include <limits>
 #include <list>
 #include <unordered_map>
 #include <utility>  // make_pair, move, pair
+#include <vector>
 
 #include "mr-cfg/identifier.hpp"
+#ifdef MR_CFG_INSTRUMENT
+#include "mr-cfg/instrument.hpp"
+#endif
 #include "mr-cfg/interval.hpp"
 #include "mr-cfg/lcp.hpp"
+#include "mr-cfg/lcp_array.hpp"
+#include "mr-cfg/maximal.hpp"
+#include "mr-cfg/pool.hpp"
+#include "mr-cfg/record.hpp"
 
 
 namespace mr_cfg {
@@ -33,6 +44,47 @@ typedef std::list<id_type> CFG_production;
 typedef std::unordered_map<id_type, CFG_production> CFG;
 
 
+//! A CFG rule as stored in interval stabbing data-structures: its ID and the
+//  length of the string it produces. Storing the length with the ID lets a
+//  stabbing query return both, so parsing needs no second lookup.
+struct CFG_rule
+{
+  id_type id;
+  uint64_t length;
+
+  bool operator==(const CFG_rule&) const = default;
+};
+
+
+}
+
+
+// interval stabbing data-structures use the max value as a placeholder for
+// NULL and hash the values they store
+template <>
+struct std::numeric_limits<mr_cfg::CFG_rule>
+{
+  static constexpr bool is_specialized = true;
+  static constexpr mr_cfg::CFG_rule max() noexcept {
+    return {
+      std::numeric_limits<mr_cfg::id_type>::max(),
+      std::numeric_limits<uint64_t>::max()
+    };
+  }
+};
+
+template <>
+struct std::hash<mr_cfg::CFG_rule>
+{
+  size_t operator()(const mr_cfg::CFG_rule& rule) const noexcept {
+    return std::hash<mr_cfg::id_type>()(rule.id);
+  }
+};
+
+
+namespace mr_cfg {
+
+
 //! Builds builds the production for a context-free grammar (CFG) rule.
 //
 // O(n), excluding CSA-specific operations, where n in the length of the string
@@ -41,8 +93,6 @@ typedef std::unordered_map<id_type, CFG_production> CFG;
  *  \param csa The compressed suffix array the CFG is being built from.
  *  \param intervals An interval stabbing data-structure containing intervals
  *    of rules already in the grammar.
- *  \param rule_production_sizes A map that associates CFG rule IDs with the
- *    length of the string they produce.
  *  \param cfg The CFG being constructed.
  *  \param i A start position of the rule's string in the input string.
  *  \param n The corresponding end position of the rule's string in the input
@@ -51,13 +101,13 @@ typedef std::unordered_map<id_type, CFG_production> CFG;
  *  \return The computed rule production.
  */
 template <class csa_wt,
+          typename position_type,
           typename size_type = typename csa_wt::size_type,
           typename character_type = typename csa_wt::wavelet_tree_type::value_type>
 CFG_production computeProduction(
   const csa_wt& csa,
-  NestedIntervalStabber<id_type>& intervals,
-  std::unordered_map<id_type, size_type>& rule_production_sizes,
-  CFG& cfg,
+  NestedIntervalStabber<CFG_rule, position_type>& intervals,
+  [[maybe_unused]] CFG& cfg,
   size_type i,
   const size_type& n)
 {
@@ -68,14 +118,14 @@ CFG_production computeProduction(
     // get the suffix array index for i
     size_type j = csa.isa[i];
     // get the longest CFG rule occurrnece that starts at i
-    const id_type* rule_id = intervals.stab(j);
+    const CFG_rule* rule = intervals.stab(j);
     // descend into the rule if it's too long; only necessary if you tinker with
     // making rules longer than reported algorithm
-    //while (rule_id != NULL && rule_production_sizes[*rule_id] > n-i) {
-    //  rule_id = &(cfg[*rule_id].front());
+    //while (rule != NULL && rule->length > n-i) {
+    //  rule = <the rule of cfg[rule->id].front()>;
     //}
     // add a terminal characer if there's no rule
-    if (rule_id == NULL) {
+    if (rule == NULL) {
       character_type c = csa.text[i];
       size_type c_id = csa.char2comp[c];  // 0 <= c_id < sigma
       production.push_back(c_id);
@@ -83,61 +133,177 @@ CFG_production computeProduction(
       i += 1;
     // otherwise, add a non-terminal character
     } else {
-      production.push_back(*rule_id);
+      production.push_back(rule->id);
       // move i to the character after this rule occurrence
-      i += rule_production_sizes[*rule_id];
+      i += rule->length;
     }
   }
   return production;
 }
 
 
+//! Adds the rule for a maximal repeat LCP-interval to a context-free grammar
+//  (CFG) and adds the interval to the interval stabbing data-structure. The
+//  rule is discarded if its production would only contain a single character.
+/*!
+ *  \param csa The compressed suffix array the CFG is being built from.
+ *  \param intervals An interval stabbing data-structure containing intervals
+ *    of rules already in the grammar.
+ *  \param cfg The CFG being constructed.
+ *  \param repeat_id The ID of the rule.
+ *  \param length The length of the string the rule produces.
+ *  \param begin The begin position of the LCP-interval.
+ *  \param end The end position of the LCP-interval.
+ *  \param i The text position of the first suffix in the LCP-interval.
+ */
+template <class csa_wt,
+          typename position_type,
+          typename size_type = typename csa_wt::size_type>
+void addRule(
+  const csa_wt& csa,
+  NestedIntervalStabber<CFG_rule, position_type>& intervals,
+  CFG& cfg,
+  const id_type& repeat_id,
+  const size_type& length,
+  const size_type& begin,
+  const size_type& end,
+  const size_type& i)
+{
+  // construct the rule
+  const size_type n = i + length;
+  cfg[repeat_id] = computeProduction(csa, intervals, cfg, i, n);
+  // add the rule's repeat to the interval stabber if it's large enough
+  if (cfg[repeat_id].size() > 1) {
+    intervals.update(begin, end, CFG_rule{repeat_id, length});
+  // otherwise, remove the rule from the CFG
+  } else {
+    cfg.erase(repeat_id);
+  }
+}
+
+
+//! Adds the rules for a batch of maximal repeat LCP-intervals with the same
+//  LCP value to a context-free grammar (CFG) and publishes their intervals.
+//  A rule's production only contains rules with lesser LCP values, so the
+//  productions of the batch are computed in parallel against the published
+//  intervals; the rules are then added in order, so the CFG is identical to
+//  the one built by adding the rules one at a time.
+/*!
+ *  \param csa The compressed suffix array the CFG is being built from.
+ *  \param intervals A concurrent interval stabbing data-structure, i.e. one
+ *    whose stabbing queries are thread-safe and only see published updates,
+ *    containing the published intervals of rules already in the grammar.
+ *  \param cfg The CFG being constructed.
+ *  \param repeats The batch of maximal repeat LCP-intervals.
+ *  \param productions A buffer for the productions of the batch.
+ *  \param pool The threads to compute the productions with.
+ */
+template <class csa_wt,
+          typename position_type,
+          typename size_type = typename csa_wt::size_type>
+void addRules(
+  const csa_wt& csa,
+  NestedIntervalStabber<CFG_rule, position_type>& intervals,
+  CFG& cfg,
+  const std::vector<MaximalRepeatInterval<size_type>>& repeats,
+  std::vector<CFG_production>& productions,
+  ThreadPool& pool)
+{
+  // compute the productions; threads take every pool.size()th repeat since
+  // the lengths of neighboring repeats' productions are correlated
+  productions.resize(repeats.size());
+  auto compute = [&](unsigned t) {
+    for (size_type k = t; k < repeats.size(); k += pool.size()) {
+      const MaximalRepeatInterval<size_type>& repeat = repeats[k];
+      productions[k] = computeProduction(
+        csa, intervals, cfg, repeat.position, repeat.position + repeat.length);
+    }
+  };
+  pool.run(compute);
+  // add the rules whose productions contain more than a single character
+  for (size_type k = 0; k < repeats.size(); ++k) {
+    const MaximalRepeatInterval<size_type>& repeat = repeats[k];
+    if (productions[k].size() > 1) {
+      cfg[repeat.id] = std::move(productions[k]);
+      intervals.update(
+        repeat.begin, repeat.end, CFG_rule{repeat.id, repeat.length});
+    }
+  }
+  intervals.publish();
+}
+
+
+//! Adds the start rule to a context-free grammar (CFG). The start rule's
+//  production is computed using a static copy of the intervals, since no more
+//  updates will be made. When compiled with MR_CFG_INSTRUMENT defined, the
+//  operations performed on the copy are reported separately from those
+//  performed while the other rules were added.
+/*!
+ *  \param csa The compressed suffix array the CFG is being built from.
+ *  \param intervals An interval stabbing data-structure containing the
+ *    intervals of every rule in the grammar.
+ *  \param cfg The CFG being constructed.
+ *  \param start_rule The ID of the start rule.
+ */
+template <class csa_wt,
+          typename position_type,
+          typename size_type = typename csa_wt::size_type>
+void addStartRule(
+  const csa_wt& csa,
+  const NestedIntervalStabber<CFG_rule, position_type>& intervals,
+  CFG& cfg,
+  id_type start_rule)
+{
+  FrozenNestedIntervalStabber<CFG_rule, position_type> frozen(intervals);
+  const size_type n = csa.size();
+#ifdef MR_CFG_INSTRUMENT
+  InstrumentedNestedIntervalStabber<CFG_rule, position_type> instrumented(frozen);
+  cfg[start_rule] = computeProduction(csa, instrumented, cfg, size_type(0), n);
+  instrumented.print(std::cout, "frozen ");
+#else
+  cfg[start_rule] = computeProduction(csa, frozen, cfg, size_type(0), n);
+#endif
+}
+
+
 //! Builds a context-free grammar (CFG) from a compressed suffix array (CSA)
-//  implemented with a FM-index and a wavelet tree.
+//  implemented with a FM-index and a wavelet tree using the given interval
+//  stabbing data-structure and source of LCP-intervals.
 //
 // O(n), excluding CSA-specific operations
 /*!
  *  \param csa The CSA.
+ *  \param intervals An empty interval stabbing data-structure.
+ *  \param lcp_intervals The source of the CSA's LCP-intervals.
  *
  *  \return The context-free grammar.
  */
-template <class csa_wt, typename size_type = typename csa_wt::size_type>
-std::pair<CFG, id_type> csaToCfg(const csa_wt& csa, const std::string& algorithm) {
-
-  size_type sigma = csa.wavelet_tree.sigma;
+template <class csa_wt,
+          typename position_type,
+          LcpIntervalSource source_type,
+          typename size_type = typename csa_wt::size_type>
+std::pair<CFG, id_type> csaToCfg(
+  const csa_wt& csa,
+  NestedIntervalStabber<CFG_rule, position_type>& intervals,
+  source_type& lcp_intervals)
+{
 
   // initialize the output CFG and the supporting size map
   CFG cfg;
   std::unordered_map<id_type, size_type> rule_production_sizes;
-  for (id_type i = 0; i < sigma; ++i) {
-    rule_production_sizes[i] = 1;
-  }
-
-  // initialize the interval stabbing data-structure
-  NestedIntervalStabber<id_type>* intervals;
-  if (algorithm == "OPTIMAL") {
-    intervals = new OptimalNestedIntervalStabber<id_type, csa_wt>(csa);
-  } else if (algorithm == "ONLINE") {
-    intervals = new OnlineNestedIntervalStabber<id_type>;
-  } else {  // "FAST"
-    intervals = new FastNestedIntervalStabber<id_type>;
-  }
-
-  // prepare to compute LCP-intervals
-  std::vector<size_type> interval;  // {LCP-value, begin, end}
-  bool loc_max;
-  auto lcp_intervals = lcp_interval_generator(csa, interval, loc_max);
 
   // initialize a position-to-ID map
   OnlineLcpIdentifiers repeat_ids(csa);
 
-  // skip the length 0 LCP-interval
-  lcp_intervals.next();
-
-  // compute LCP-intervals
-  for (auto left_extensions: lcp_intervals) {
+  // compute LCP-intervals in order
+  for_each_lcp_interval(lcp_intervals, [&](const auto& interval) {
+    // skip the length 0 LCP-interval
+    if (interval.lcp == 0) {
+      return;
+    }
     // compute the repeat's ID
-    id_type repeat_id = repeat_ids.getId(interval[0], interval[1], interval[2]);
+    id_type repeat_id =
+      repeat_ids.getId(interval.lcp, interval.begin, interval.end);
     // create a rule in the CFG for the ID if necessary
     if (!rule_production_sizes.contains(repeat_id)) {
       // actually don't need to create the rule; just the the size
@@ -145,38 +311,408 @@ std::pair<CFG, id_type> csaToCfg(const csa_wt& csa, const std::string& algorithm
     }
     rule_production_sizes[repeat_id] += 1;
     // check if the interval is maximal
-    if (*left_extensions > 1) {
-      // construct the rule
-      size_type i = csa[interval[1]];
-      const size_type n = i + rule_production_sizes[repeat_id];
-      cfg[repeat_id] =
-        computeProduction(csa, *intervals, rule_production_sizes, cfg, i, n);
-      // add the rule's repeat to the interval stabber if it's large enough
-      if (cfg[repeat_id].size() > 1) {
-        //intervals.update(interval[1], interval[2], repeat_id);
-        intervals->update(interval[1], interval[2], repeat_id);
-      // otherwise, remove the rule from the CFG
-      } else {
-        cfg.erase(repeat_id);
-        rule_production_sizes.erase(repeat_id);
-      }
+    if (interval.left_extensions > 1) {
+      // add the rule; its size is final so it's no longer needed
+      size_type i = csa[interval.begin];
+      addRule(
+        csa, intervals, cfg,
+        repeat_id, rule_production_sizes[repeat_id],
+        interval.begin, interval.end, i);
+      rule_production_sizes.erase(repeat_id);
       // erase the ID to guarantee left-extensions will use a different ID
-      repeat_ids.removeId(interval[0], interval[1], interval[2]);
+      repeat_ids.removeId(interval.lcp, interval.begin, interval.end);
     }
+  });
+
+  // compute the start rule
+  id_type start_rule = repeat_ids.getNextId();
+  addStartRule(csa, intervals, cfg, start_rule);
+
+  return std::make_pair(std::move(cfg), start_rule);
+
+}
+
+
+//! Builds a context-free grammar (CFG) from a compressed suffix array (CSA)
+//  implemented with a FM-index and a wavelet tree using the given interval
+//  stabbing data-structure and source of maximal repeat LCP-intervals. Unlike
+//  with other sources, no work is done for LCP-intervals that aren't maximal.
+//
+// O(n), excluding CSA-specific operations
+/*!
+ *  \param csa The CSA.
+ *  \param intervals An empty interval stabbing data-structure.
+ *  \param repeats The source of the CSA's maximal repeat LCP-intervals.
+ *
+ *  \return The context-free grammar.
+ */
+template <class csa_wt,
+          typename position_type,
+          typename size_type = typename csa_wt::size_type>
+std::pair<CFG, id_type> csaToCfg(
+  const csa_wt& csa,
+  NestedIntervalStabber<CFG_rule, position_type>& intervals,
+  MaximalRepeatEnumerator<csa_wt>& repeats)
+{
+
+  // initialize the output CFG
+  CFG cfg;
+
+  // add a rule for each maximal repeat as it's computed
+  for_each_lcp_interval(repeats, [&](const auto& repeat) {
+    addRule(
+      csa, intervals, cfg,
+      repeat.id, repeat.length, repeat.begin, repeat.end, repeat.position);
+  });
+
+  // compute the start rule
+  id_type start_rule = repeats.getNextId();
+  addStartRule(csa, intervals, cfg, start_rule);
+
+  return std::make_pair(std::move(cfg), start_rule);
+
+}
+
+
+//! Builds a context-free grammar (CFG) from a compressed suffix array (CSA)
+//  implemented with a FM-index and a wavelet tree using the given interval
+//  stabbing data-structure. LCP-intervals are computed with the CSA.
+//
+// O(n), excluding CSA-specific operations
+/*!
+ *  \param csa The CSA.
+ *  \param intervals An empty interval stabbing data-structure.
+ *  \param num_threads The number of threads to compute LCP-intervals with.
+ *  \param statistics Where to output statistics about the memory used to
+ *    compute LCP-intervals, if not NULL.
+ *
+ *  \return The context-free grammar.
+ */
+template <class csa_wt,
+          typename position_type,
+          typename size_type = typename csa_wt::size_type>
+std::pair<CFG, id_type> csaToCfg(
+  const csa_wt& csa,
+  NestedIntervalStabber<CFG_rule, position_type>& intervals,
+  unsigned num_threads = 1,
+  LcpIntervalStatistics* statistics = NULL)
+{
+  LcpIntervalEnumerator<csa_wt> lcp_intervals(csa, num_threads);
+  auto cfg = csaToCfg(csa, intervals, lcp_intervals);
+  if (statistics != NULL) {
+    *statistics = lcp_intervals.statistics();
   }
+  return cfg;
+}
+
+
+//! Builds a context-free grammar (CFG) from a compressed suffix array (CSA)
+//  implemented with a FM-index and a wavelet tree using the given concurrent
+//  interval stabbing data-structure and source of LCP-intervals. The rules of
+//  each LCP value are computed in parallel (see addRules).
+//
+// O(n), excluding CSA-specific operations
+/*!
+ *  \param csa The CSA.
+ *  \param intervals An empty concurrent interval stabbing data-structure
+ *    (see addRules).
+ *  \param lcp_intervals The source of the CSA's LCP-intervals.
+ *  \param num_threads The number of threads to compute rules with.
+ *
+ *  \return The context-free grammar.
+ */
+template <class csa_wt,
+          typename position_type,
+          LcpIntervalSource source_type,
+          typename size_type = typename csa_wt::size_type>
+std::pair<CFG, id_type> csaToCfg(
+  const csa_wt& csa,
+  NestedIntervalStabber<CFG_rule, position_type>& intervals,
+  source_type& lcp_intervals,
+  unsigned num_threads)
+{
+
+  // initialize the output CFG and the supporting size map
+  CFG cfg;
+  std::unordered_map<id_type, size_type> rule_production_sizes;
+
+  // initialize a position-to-ID map
+  OnlineLcpIdentifiers repeat_ids(csa);
+
+  // the maximal repeats of the current LCP value
+  ThreadPool pool(num_threads);
+  std::vector<MaximalRepeatInterval<size_type>> batch;
+  std::vector<CFG_production> productions;
+
+  // compute LCP-intervals in order
+  for_each_lcp_interval(lcp_intervals, [&](const auto& interval) {
+    // skip the length 0 LCP-interval
+    if (interval.lcp == 0) {
+      return;
+    }
+    // add the rules of the previous LCP value
+    if (!batch.empty() && interval.lcp != batch.back().lcp) {
+      addRules(csa, intervals, cfg, batch, productions, pool);
+      batch.clear();
+    }
+    // compute the repeat's ID
+    id_type repeat_id =
+      repeat_ids.getId(interval.lcp, interval.begin, interval.end);
+    rule_production_sizes[repeat_id] += 1;
+    // check if the interval is maximal
+    if (interval.left_extensions > 1) {
+      // batch the rule; its size is final so it's no longer needed
+      batch.push_back({
+        interval.lcp, interval.begin, interval.end,
+        repeat_id, rule_production_sizes[repeat_id], csa[interval.begin]});
+      rule_production_sizes.erase(repeat_id);
+      // erase the ID to guarantee left-extensions will use a different ID
+      repeat_ids.removeId(interval.lcp, interval.begin, interval.end);
+    }
+  });
+  addRules(csa, intervals, cfg, batch, productions, pool);
 
   // compute the start rule
   id_type start_rule = repeat_ids.getNextId();
-  size_type i = 0;
-  const size_type n = csa.size();
-  cfg[start_rule] =
-    computeProduction(csa, *intervals, rule_production_sizes, cfg, i, n);
+  addStartRule(csa, intervals, cfg, start_rule);
+
+  return std::make_pair(std::move(cfg), start_rule);
+
+}
+
+
+//! Builds a context-free grammar (CFG) from a compressed suffix array (CSA)
+//  implemented with a FM-index and a wavelet tree using the given concurrent
+//  interval stabbing data-structure and source of maximal repeat
+//  LCP-intervals. The rules of each LCP value are computed in parallel (see
+//  addRules).
+//
+// O(n), excluding CSA-specific operations
+/*!
+ *  \param csa The CSA.
+ *  \param intervals An empty concurrent interval stabbing data-structure
+ *    (see addRules).
+ *  \param repeats The source of the CSA's maximal repeat LCP-intervals.
+ *  \param num_threads The number of threads to compute rules with.
+ *
+ *  \return The context-free grammar.
+ */
+template <class csa_wt,
+          typename position_type,
+          typename size_type = typename csa_wt::size_type>
+std::pair<CFG, id_type> csaToCfg(
+  const csa_wt& csa,
+  NestedIntervalStabber<CFG_rule, position_type>& intervals,
+  MaximalRepeatEnumerator<csa_wt>& repeats,
+  unsigned num_threads)
+{
+
+  // initialize the output CFG
+  CFG cfg;
+
+  // add the rules of each LCP value as a batch
+  ThreadPool pool(num_threads);
+  std::vector<MaximalRepeatInterval<size_type>> batch;
+  std::vector<CFG_production> productions;
+  while (repeats.nextBatch(batch, 0) > 0) {
+    addRules(csa, intervals, cfg, batch, productions, pool);
+  }
+
+  // compute the start rule
+  id_type start_rule = repeats.getNextId();
+  addStartRule(csa, intervals, cfg, start_rule);
 
   return std::make_pair(std::move(cfg), start_rule);
 
 }
 
 
+//! Builds a context-free grammar (CFG) from the recorded maximal repeat
+//  LCP-intervals of a compressed suffix array (CSA) implemented with a
+//  FM-index and a wavelet tree using the given interval stabbing
+//  data-structure.
+//
+// O(n), excluding CSA-specific operations
+/*!
+ *  \param csa The CSA.
+ *  \param intervals An empty interval stabbing data-structure.
+ *  \param record The recorded maximal repeat LCP-intervals of the CSA.
+ *
+ *  \return The context-free grammar.
+ */
+template <class csa_wt,
+          typename position_type,
+          typename size_type = typename csa_wt::size_type>
+std::pair<CFG, id_type> csaToCfg(
+  const csa_wt& csa,
+  NestedIntervalStabber<CFG_rule, position_type>& intervals,
+  const MaximalIntervalRecord<csa_wt>& record)
+{
+
+  // initialize the output CFG
+  CFG cfg;
+
+  // add a rule for each maximal repeat in the order they were computed
+  for (size_type k = 0; k < record.size(); ++k) {
+    addRule(
+      csa, intervals, cfg,
+      record.id(k), record.length(k), record.begin(k), record.end(k),
+      record.position(k));
+  }
+
+  // compute the start rule
+  id_type start_rule = record.getNextId();
+  addStartRule(csa, intervals, cfg, start_rule);
+
+  return std::make_pair(std::move(cfg), start_rule);
+
+}
+
+
+//! Builds a context-free grammar (CFG) from a compressed suffix array (CSA)
+//  implemented with a FM-index and a wavelet tree using interval stabbing
+//  data-structures that store positions of the given width and the given
+//  source of LCP-intervals.
+/*!
+ *  \param csa The CSA.
+ *  \param algorithm The interval stabbing algorithm to use.
+ *  \param lcp_intervals The source of the CSA's LCP-intervals.
+ *  \param num_threads The number of threads to compute rules with if the
+ *    algorithm is CONCURRENT.
+ *
+ *  \return The context-free grammar.
+ */
+template <typename position_type,
+          class csa_wt,
+          LcpIntervalSource source_type,
+          typename size_type = typename csa_wt::size_type>
+std::pair<CFG, id_type> csaToCfg(
+  const csa_wt& csa,
+  const std::string& algorithm,
+  source_type& lcp_intervals,
+  unsigned num_threads = 1)
+{
+  // the OPTIMAL data-structure and the CFG share a single LCP-interval
+  // enumeration
+  if (algorithm == "OPTIMAL") {
+    MaximalIntervalRecord<csa_wt> record(csa, lcp_intervals);
+    OptimalNestedIntervalStabber<CFG_rule, csa_wt, position_type> intervals(record);
+#ifdef MR_CFG_INSTRUMENT
+    InstrumentedNestedIntervalStabber<CFG_rule, position_type> instrumented(intervals);
+    auto cfg = csaToCfg(csa, instrumented, record);
+    instrumented.print(std::cout);
+    return cfg;
+#else
+    return csaToCfg(csa, intervals, record);
+#endif
+  }
+  // the CONCURRENT data-structure is stabbed by several threads
+  if (algorithm == "CONCURRENT") {
+    ConcurrentNestedIntervalStabber<CFG_rule, position_type> intervals;
+#ifdef MR_CFG_INSTRUMENT
+    InstrumentedNestedIntervalStabber<CFG_rule, position_type> instrumented(intervals);
+    auto cfg = csaToCfg(csa, instrumented, lcp_intervals, num_threads);
+    instrumented.print(std::cout);
+    return cfg;
+#else
+    return csaToCfg(csa, intervals, lcp_intervals, num_threads);
+#endif
+  }
+  auto intervals =
+    makeNestedIntervalStabber<CFG_rule, position_type>(algorithm, csa);
+#ifdef MR_CFG_INSTRUMENT
+  InstrumentedNestedIntervalStabber<CFG_rule, position_type> instrumented(*intervals);
+  auto cfg = csaToCfg(csa, instrumented, lcp_intervals);
+  instrumented.print(std::cout);
+  return cfg;
+#else
+  return csaToCfg(csa, *intervals, lcp_intervals);
+#endif
+}
+
+
+//! Builds a context-free grammar (CFG) from a compressed suffix array (CSA)
+//  implemented with a FM-index and a wavelet tree using interval stabbing
+//  data-structures that store positions of the given width.
+/*!
+ *  \param csa The CSA.
+ *  \param algorithm The interval stabbing algorithm to use.
+ *  \param num_threads The number of threads to compute LCP-intervals and,
+ *    if the algorithm is CONCURRENT, rules with.
+ *  \param statistics Where to output statistics about the memory used to
+ *    compute LCP-intervals, if not NULL.
+ *  \param interval_source Where to compute LCP-intervals from: "CSA" computes
+ *    them with the CSA itself in little memory, "MAXIMAL" computes only the
+ *    maximal ones with the CSA, which is faster but queues O(n) words, and
+ *    "LCP" computes them faster still from an LCP array.
+ *
+ *  \return The context-free grammar.
+ */
+template <typename position_type,
+          class csa_wt,
+          typename size_type = typename csa_wt::size_type>
+std::pair<CFG, id_type> csaToCfg(
+  const csa_wt& csa,
+  const std::string& algorithm,
+  unsigned num_threads = 1,
+  LcpIntervalStatistics* statistics = NULL,
+  const std::string& interval_source = "CSA")
+{
+  if (interval_source == "LCP") {
+    LcpArrayIntervalSource<csa_wt> lcp_intervals(csa);
+    return csaToCfg<position_type>(csa, algorithm, lcp_intervals, num_threads);
+  }
+  if (interval_source == "MAXIMAL") {
+    MaximalRepeatEnumerator<csa_wt> repeats(csa, num_threads);
+    auto cfg = csaToCfg<position_type>(csa, algorithm, repeats, num_threads);
+    if (statistics != NULL) {
+      *statistics = repeats.statistics();
+    }
+    return cfg;
+  }
+  LcpIntervalEnumerator<csa_wt> lcp_intervals(csa, num_threads);
+  auto cfg = csaToCfg<position_type>(csa, algorithm, lcp_intervals, num_threads);
+  if (statistics != NULL) {
+    *statistics = lcp_intervals.statistics();
+  }
+  return cfg;
+}
+
+
+//! Builds a context-free grammar (CFG) from a compressed suffix array (CSA)
+//  implemented with a FM-index and a wavelet tree.
+//
+//  Positions are stored in 32 bits when the CSA is smaller than 2^32, which
+//  halves the size of the interval stabbing data-structures.
+/*!
+ *  \param csa The CSA.
+ *  \param algorithm The interval stabbing algorithm to use.
+ *  \param num_threads The number of threads to compute LCP-intervals and,
+ *    if the algorithm is CONCURRENT, rules with.
+ *  \param statistics Where to output statistics about the memory used to
+ *    compute LCP-intervals, if not NULL.
+ *  \param interval_source Where to compute LCP-intervals from: "CSA",
+ *    "MAXIMAL", or "LCP".
+ *
+ *  \return The context-free grammar.
+ */
+template <class csa_wt, typename size_type = typename csa_wt::size_type>
+std::pair<CFG, id_type> csaToCfg(
+  const csa_wt& csa,
+  const std::string& algorithm,
+  unsigned num_threads = 1,
+  LcpIntervalStatistics* statistics = NULL,
+  const std::string& interval_source = "CSA")
+{
+  if (csa.size() <= std::numeric_limits<uint32_t>::max()) {
+    return csaToCfg<uint32_t>(
+      csa, algorithm, num_threads, statistics, interval_source);
+  }
+  return csaToCfg<uint64_t>(
+    csa, algorithm, num_threads, statistics, interval_source);
+}
+
+
 //! Prints a context-free grammar (CFG) to the standard error.
 /*!
  *  \param csa The compressed suffix array the grammar was built from.
@@ -0,0 +1,442 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDED_MR_CFG_COST
+#define INCLUDED_MR_CFG_COST
+
+#include <algorithm>  // max, min
+#include <cmath>  // ceil, exp, floor, log2
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "mr-cfg/cfg.hpp"
+#include "mr-cfg/lcp.hpp"
+
+
+namespace mr_cfg {
+
+
+//! Cheap statistics about a string that the costs of the interval stabbing
+//  algorithms are predicted from.
+struct StabberStatistics
+{
+  // the length of the string, including the terminating character
+  double n;
+  // the size of the alphabet
+  double sigma;
+  // the (estimated) number of LCP-intervals
+  double intervals;
+  // the (estimated) number of maximal repeats
+  double repeats;
+  // the (estimated) average number of maximal repeat intervals that contain
+  // a position, i.e. the average nesting depth
+  double depth;
+  // whether the values are exact rather than estimates
+  bool exact;
+};
+
+
+//! The predicted cost of an interval stabbing algorithm.
+struct StabberCost
+{
+  std::string algorithm;
+  // predicted run-time in seconds of the preprocessing, updates, and stabbing
+  // queries made by the algorithm's data-structure while building the grammar
+  double seconds;
+  // predicted peak memory of the data-structure in bytes
+  double bytes;
+};
+
+
+//! Computes statistics about the string a compressed suffix array (CSA) was
+//  built from by sampling its LCP-intervals. The intervals are enumerated
+//  shortest LCP value first; if the enumeration finishes within its budget
+//  the values are exact. Otherwise, the intervals of the remaining LCP values
+//  are extrapolated from the last LCP values that were finished: if their
+//  number of intervals is decreasing it's assumed to keep decreasing
+//  geometrically, otherwise the string is assumed to have n-1 intervals,
+//  which is the most a string of length n can have. The remaining intervals
+//  are maximal repeats as often, and as wide, as the sampled intervals of the
+//  last LCP values.
+/*!
+ *  \param csa The CSA.
+ *  \param interval_budget The number of LCP-intervals to enumerate; 0 means
+ *    n/16.
+ *
+ *  \return The statistics.
+ */
+template <class csa_wt, typename size_type = typename csa_wt::size_type>
+StabberStatistics computeStabberStatistics(
+  const csa_wt& csa,
+  size_type interval_budget = 0)
+{
+  StabberStatistics statistics;
+  const size_type n = csa.size();
+  statistics.n = n;
+  statistics.sigma = csa.sigma;
+
+  // the sampled intervals, maximal repeats, and maximal repeat widths of each
+  // LCP value
+  struct Level
+  {
+    double intervals = 0;
+    double repeats = 0;
+    double width = 0;
+  };
+  std::vector<Level> levels;
+
+  // sample the LCP-intervals
+  if (interval_budget == 0) {
+    interval_budget = n/16 + 1024;
+  }
+  size_type num_intervals = 0;
+  size_type lcp = 0;
+  statistics.exact = true;
+  for_each_lcp_interval(csa, [&](const auto& interval) {
+    // skip the length 0 LCP-interval
+    if (interval.lcp == 0) {
+      return true;
+    }
+    if (num_intervals == interval_budget) {
+      statistics.exact = false;
+      return false;
+    }
+    num_intervals += 1;
+    if (levels.empty() || interval.lcp != lcp) {
+      levels.emplace_back();
+      lcp = interval.lcp;
+    }
+    levels.back().intervals += 1;
+    if (interval.left_extensions > 1) {
+      levels.back().repeats += 1;
+      levels.back().width += interval.end - interval.begin + 1;
+    }
+    return true;
+  });
+  Level total;
+  for (const Level& level: levels) {
+    total.intervals += level.intervals;
+    total.repeats += level.repeats;
+    total.width += level.width;
+  }
+
+  // extrapolate the intervals of the remaining LCP values; the last sampled
+  // LCP value is only partially enumerated
+  if (!statistics.exact) {
+    const size_t k = levels.size();
+    double remaining = std::max(0.0, (n-1) - total.intervals);
+    if (k >= 3 && levels[k-2].intervals < levels[k-3].intervals) {
+      const double ratio = levels[k-2].intervals / levels[k-3].intervals;
+      const double tail = levels[k-2].intervals * ratio / (1 - ratio);
+      remaining =
+        std::min(remaining, std::max(0.0, tail - levels[k-1].intervals));
+    }
+    Level last = levels[k-1];
+    if (k >= 2) {
+      last.intervals += levels[k-2].intervals;
+      last.repeats += levels[k-2].repeats;
+      last.width += levels[k-2].width;
+    }
+    const double repeats = remaining * last.repeats / last.intervals;
+    total.intervals += remaining;
+    total.repeats += repeats;
+    if (last.repeats > 0) {
+      total.width += repeats * last.width / last.repeats;
+    }
+  }
+  statistics.intervals = total.intervals;
+  statistics.repeats = total.repeats;
+  statistics.depth = std::max(1.0, total.width / n);
+
+  return statistics;
+}
+
+
+// the costs of the interval stabbing algorithms are machine-specific; the
+// constants below were printed, in this form, by
+//   MR-CFG-bench-calibrate 2097152 2 0
+// built with the default Release flags on a single core of a virtualized Intel
+// Xeon, and should be re-measured with it on the machine MR-CFG runs on. The
+// dynamic data-structures' costs are the update, stab, and boundaries times
+// divided by the number of intervals, queries, and boundaries for random
+// laminar families of depth 5, 9, 13, 17, and 21 over 2^24 positions, whose
+// last levels have about 2^7, 2^11, 2^15, 2^19, and 2^23 interval boundaries;
+// OPTIMAL's costs are modeled by counting its memory accesses
+
+//! The measured costs of a dynamic interval stabbing data-structure, in
+//  nanoseconds, at 2^7, 2^11, 2^15, 2^19, and 2^23 interval boundaries.
+struct StabberCalibration
+{
+  double stab_ns[5];
+  double update_ns[5];
+  double boundary_ns[5];
+  // the peak bytes per interval of any of the families
+  double interval_bytes;
+};
+
+const StabberCalibration ONLINE_CALIBRATION{
+  {54, 115, 206, 618, 1100},
+  {305, 363, 369, 428, 435},
+  {59, 22, 11, 15, 36},
+  113};
+
+const StabberCalibration LSM_CALIBRATION{
+  {49, 156, 185, 323, 483},
+  {309, 294, 274, 467, 465},
+  {56, 24, 17, 24, 26},
+  69};
+
+// CONCURRENT publishes the intervals of each LCP value, so it's measured
+// publishing each depth of the families
+const StabberCalibration CONCURRENT_CALIBRATION{
+  {64, 113, 134, 197, 323},
+  {693, 890, 715, 1136, 1232},
+  {95, 53, 36, 64, 80},
+  219};
+
+// FAST's update cost depends on the number of chunks rather than the number
+// of intervals, so only its stabbing queries and boundaries are interpolated
+const StabberCalibration FAST_CALIBRATION{
+  {52, 108, 126, 190, 192},
+  {0, 0, 0, 0, 0},
+  {78, 19, 7, 6, 8},
+  0};
+
+// the cost of adding a position to a FAST chunk once it exists and of moving
+// a chunk to insert a new chunk before it; both are fit to FAST's measured
+// update times by least squares
+const double FAST_POSITION_NS = 88;
+const double FAST_CHUNK_MOVE_NS = 3.8;
+// the positions per FAST chunk and the bytes of an empty chunk and its key;
+// a chunk's bitmap container adds a word and an ID vector per 64 positions.
+// These follow from FastNestedIntervalStabber's layout rather than being
+// measured
+const double FAST_CHUNK_POSITIONS = 4096;
+const double FAST_CHUNK_BYTES = 112;
+const double FAST_BITMAP_BYTES = 64 * 32;
+
+// the measured latency in nanoseconds of a random access to 2^19, 2^23,
+// 2^26, and 2^28 bytes, i.e. of dependent loads in a random cycle
+const double LATENCY_BYTES[4] = {1 << 19, 1 << 23, 1 << 26, 1 << 28};
+const double LATENCY_NS[4] = {6.9, 41.6, 137.4, 193.7};
+// the measured per-position cost of a sequential scan of a bit vector that
+// computes the rank of every position, as OPTIMAL's preprocessing does; it
+// depends on whether the compiler emits a popcount instruction
+const double SEQUENTIAL_NS = 20.2;
+// the measured cost of a SuccessorBitVector successor query and insertion
+const double SUCCESSOR_NS = 20.1;
+const double SUCCESSOR_ADD_NS = 1.9;
+
+// the number of stabbing queries made per rule, i.e. the size of a rule's
+// production, which has at least two symbols and is parsed with the longest
+// rules already in the grammar; this is an estimate rather than a measurement
+// and MR_CFG_INSTRUMENT builds report the actual number of queries
+const double QUERIES_PER_RULE = 3;
+
+
+//! Interpolates a calibrated cost at the given number of interval boundaries
+//  in the log of the number of boundaries. Costs beyond 2^23 boundaries are
+//  extrapolated from the last two measurements since they keep growing with
+//  the log of the number of boundaries.
+inline double interpolateCost(const double (&costs)[5], double boundaries) {
+  const double x =
+    std::max(0.0, (std::log2(std::max(1.0, boundaries)) - 7) / 4);
+  const int k = std::min(3, int(std::floor(x)));
+  return std::max(0.0, costs[k] + (x - k) * (costs[k+1] - costs[k]));
+}
+
+
+//! Interpolates the measured latency of a random access to a data-structure
+//  of the given size in the log of its size.
+inline double memoryLatency(double bytes) {
+  if (bytes <= LATENCY_BYTES[0]) {
+    return LATENCY_NS[0];
+  }
+  for (int k = 1; k < 4; ++k) {
+    if (bytes <= LATENCY_BYTES[k]) {
+      const double t =
+        std::log2(bytes / LATENCY_BYTES[k-1]) /
+        std::log2(LATENCY_BYTES[k] / LATENCY_BYTES[k-1]);
+      return LATENCY_NS[k-1] + t * (LATENCY_NS[k] - LATENCY_NS[k-1]);
+    }
+  }
+  return LATENCY_NS[3];
+}
+
+
+//! Predicts the run-time and memory of a dynamic interval stabbing algorithm
+//  from its calibration.
+/*!
+ *  \param algorithm The name of the algorithm.
+ *  \param calibration The algorithm's measured costs.
+ *  \param s The statistics of the string the grammar will be built from.
+ *  \param num_threads The number of threads stabbing queries are divided
+ *    between.
+ *
+ *  \return The predicted cost.
+ */
+inline StabberCost predictStabberCost(
+  const std::string& algorithm,
+  const StabberCalibration& calibration,
+  const StabberStatistics& s,
+  unsigned num_threads = 1)
+{
+  const double boundaries = 2 * s.repeats;
+  const double queries = QUERIES_PER_RULE * s.repeats;
+  StabberCost cost{algorithm, 0, 0};
+  cost.seconds = 1e-9 * (
+    s.repeats * interpolateCost(calibration.update_ns, boundaries) +
+    queries * interpolateCost(calibration.stab_ns, boundaries) / num_threads +
+    // the start rule is parsed with a frozen copy made from the boundaries
+    boundaries * interpolateCost(calibration.boundary_ns, boundaries));
+  cost.bytes = s.repeats * calibration.interval_bytes;
+  return cost;
+}
+
+
+//! Predicts the run-time and memory of each interval stabbing algorithm. The
+//  run-time is the cost of the data-structure's preprocessing, of updating it
+//  with each maximal repeat's rule, of the stabbing queries that compute the
+//  rules' productions, and of copying its boundaries to the frozen copy the
+//  start rule is parsed with. The start rule's queries and the LCP-interval
+//  enumeration cost the same with every algorithm, so they're not included.
+/*!
+ *  \param s The statistics of the string the grammar will be built from.
+ *  \param num_threads The number of threads CONCURRENT would use.
+ *
+ *  \return The predicted cost of each algorithm.
+ */
+inline std::vector<StabberCost> predictStabberCosts(
+  const StabberStatistics& s,
+  unsigned num_threads = 1)
+{
+  const double m = std::max(1.0, s.repeats);
+  const double boundaries = 2 * m;
+  const double queries = QUERIES_PER_RULE * m;
+  std::vector<StabberCost> costs;
+
+  // OPTIMAL: a rank over a bit vector of the n positions, a lookup, and a
+  // successor query per run of the stabbed interval's heavy-path ID, of
+  // which there are O(log m); preprocessing scans every position and makes a
+  // few random accesses and about ten sequential passes per maximal repeat
+  const double runs = std::min(s.depth, std::log2(std::max(2.0, m)));
+  const double m_bits = std::ceil(std::log2(m + 1));
+  const double rank_bytes = s.n * 1.0625 / 8;  // bits and rank_support_v5
+  const double lookup_bytes = boundaries * m_bits / 8;
+  const double id_bytes =
+    m * std::ceil(std::log2(m * runs + 1)) / 8 +  // run offsets
+    2 * m * runs * m_bits / 8;                     // runs
+  const double map_bytes = m * sizeof(CFG_rule);
+  const double record_bytes =
+    5 * m * std::ceil(std::log2(2 * s.n + s.sigma)) / 8;
+  const double rank_ns = 2 * memoryLatency(rank_bytes);
+  const double ancestor_ns =
+    2 * memoryLatency(id_bytes) + runs * SUCCESSOR_NS +
+    memoryLatency(map_bytes);
+  const double stab_ns = rank_ns + memoryLatency(lookup_bytes) + ancestor_ns;
+  StabberCost optimal{"OPTIMAL", 0, 0};
+  optimal.seconds = 1e-9 * (
+    s.n * SEQUENTIAL_NS +
+    m * (3 * rank_ns + 5 * memoryLatency(m * m_bits / 8) +
+         (10 + 2 * runs) * SEQUENTIAL_NS) +
+    m * (2 * stab_ns + SUCCESSOR_ADD_NS) +
+    queries * stab_ns +
+    boundaries * ancestor_ns);
+  optimal.bytes =
+    rank_bytes + lookup_bytes + id_bytes + map_bytes + record_bytes +
+    m / 8 * 64 / 63;  // successor bit vector
+  costs.push_back(optimal);
+
+  costs.push_back(predictStabberCost("ONLINE", ONLINE_CALIBRATION, s));
+  costs.push_back(predictStabberCost("LSM", LSM_CALIBRATION, s));
+
+  // FAST: chunks are kept in a sorted vector, so creating one moves half of
+  // the existing chunks on average
+  const double max_chunks = std::max(1.0, s.n / FAST_CHUNK_POSITIONS);
+  const double chunks =
+    max_chunks * (1 - std::exp(-boundaries / max_chunks));
+  StabberCost fast = predictStabberCost("FAST", FAST_CALIBRATION, s);
+  fast.seconds += 1e-9 * (
+    boundaries * FAST_POSITION_NS +
+    chunks * chunks / 2 * FAST_CHUNK_MOVE_NS);
+  fast.bytes =
+    chunks * FAST_CHUNK_BYTES +
+    boundaries * (sizeof(uint16_t) + sizeof(CFG_rule)) * 1.25;
+  if (boundaries / chunks > 256) {
+    fast.bytes += chunks * FAST_BITMAP_BYTES;
+  }
+  costs.push_back(fast);
+
+  // CONCURRENT: only the stabbing queries are divided between the threads;
+  // the writer's map and publishing make it slower than ONLINE with one
+  costs.push_back(
+    predictStabberCost("CONCURRENT", CONCURRENT_CALIBRATION, s, num_threads));
+
+  return costs;
+}
+
+
+//! Chooses the interval stabbing algorithm with the lowest predicted run-time
+//  for the string a compressed suffix array (CSA) was built from, breaking
+//  near-ties by memory, and reports the statistics and predictions the choice
+//  was based on. The predictions are only as accurate as the calibration
+//  constants are for the machine MR-CFG runs on.
+/*!
+ *  \param csa The CSA.
+ *  \param out The stream to report the choice to.
+ *  \param num_threads The number of threads the grammar will be built with.
+ *
+ *  \return The name of the chosen algorithm.
+ */
+template <class csa_wt>
+std::string chooseNestedIntervalStabber(
+  const csa_wt& csa,
+  std::ostream& out,
+  unsigned num_threads = 1)
+{
+  const StabberStatistics statistics = computeStabberStatistics(csa);
+  const std::vector<StabberCost> costs =
+    predictStabberCosts(statistics, num_threads);
+
+  const std::string kind = statistics.exact ? "" : "estimated ";
+  out << "\t" << kind << "LCP-intervals: " << statistics.intervals << std::endl;
+  out << "\t" << kind << "maximal repeats: " << statistics.repeats << std::endl;
+  out << "\t" << kind << "average nesting depth: " << statistics.depth << std::endl;
+
+  const StabberCost* best = &costs.front();
+  for (const StabberCost& cost: costs) {
+    out << "\t" << cost.algorithm << ": predicted " << cost.seconds << "s, "
+        << cost.bytes / (1024*1024) << "MB" << std::endl;
+    // prefer less memory when the run-times are within 10%
+    if (cost.seconds < best->seconds * 0.9 ||
+        (cost.seconds < best->seconds * 1.1 && cost.bytes < best->bytes))
+    {
+      best = &cost;
+    }
+  }
+  out << "\tchose " << best->algorithm
+      << ": lowest predicted run-time, with ties broken by memory" << std::endl;
+  out << "\tpredictions are extrapolated from costs measured on a reference"
+      << " machine with MR-CFG-bench-calibrate; see cost.hpp" << std::endl;
+
+  return best->algorithm;
+}
+
+
+}
+
+#endif
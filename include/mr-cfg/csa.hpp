@@ -0,0 +1,176 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDED_MR_CFG_CSA
+#define INCLUDED_MR_CFG_CSA
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sdsl/construct.hpp>
+#include <sdsl/csa_wt.hpp>
+#include <sdsl/int_vector.hpp>
+#include <sdsl/rrr_vector.hpp>
+#include <sdsl/wavelet_trees.hpp>
+
+#include "mr-cfg/packed.hpp"
+#include "mr-cfg/rlbwt.hpp"
+#include "mr-cfg/sampled.hpp"
+
+
+namespace mr_cfg {
+
+
+//! The compressed suffix array (CSA) configurations that can be selected at
+//  run-time. A configuration is named by how the BWT is represented,
+//  optionally followed by a colon and the SA sample density; the ISA sample
+//  density is always twice the SA's, as in sdsl's default csa_wt, e.g.
+//  "WT_HUFF" (which is "WT_HUFF:32") or "WT_INT:8".
+//
+//  WT_HUFF, WT_INT, and WT_BLCD are sdsl::csa_wt with a Huffman-shaped,
+//  integer, and balanced wavelet tree, respectively; WT_HUFF_RRR is a
+//  Huffman-shaped wavelet tree of RRR compressed bit vectors; RLBWT is a
+//  RunLengthCsa; and PACKED is a PackedCsa, which only supports texts with at
+//  most 8 distinct characters. sdsl's sample densities are template
+//  parameters, so only the densities below are compiled.
+const std::vector<std::string> CSA_WAVELET_TREES =
+  {"WT_HUFF", "WT_INT", "WT_BLCD", "WT_HUFF_RRR", "RLBWT", "PACKED"};
+const std::vector<uint32_t> CSA_SAMPLE_DENSITIES = {8, 32, 128};
+
+
+//! Gets the names of every CSA configuration.
+inline std::vector<std::string> csaConfigurations() {
+  std::vector<std::string> configurations;
+  for (const std::string& wavelet_tree: CSA_WAVELET_TREES) {
+    for (const uint32_t& density: CSA_SAMPLE_DENSITIES) {
+      configurations.push_back(wavelet_tree + ":" + std::to_string(density));
+    }
+  }
+  return configurations;
+}
+
+
+//! Gets the number of bytes a CSA uses.
+template <class csa_type>
+uint64_t csaSizeInBytes(const csa_type& csa) {
+  return sdsl::size_in_bytes(csa);
+}
+
+//! Gets the number of bytes a sampled CSA, e.g. a RunLengthCsa, uses.
+template <class bwt_type>
+uint64_t csaSizeInBytes(const SampledCsa<bwt_type>& csa) {
+  return csa.sizeInBytes();
+}
+
+
+//! Constructs an sdsl::csa_wt of a text and calls a function with it.
+template <class wt_type,
+          uint32_t sa_density,
+          class function_type>
+void withCsaWt(const sdsl::int_vector<8>& text, function_type& function) {
+  sdsl::csa_wt<wt_type, sa_density, 2*sa_density> csa;
+  sdsl::construct_im(csa, text);
+  function(csa);
+}
+
+
+//! Constructs a CSA of a text with the given BWT representation and sample
+//  density and calls a function with it.
+template <uint32_t sa_density, class function_type>
+bool withSampledCsa(
+  const std::string& wavelet_tree,
+  const sdsl::int_vector<8>& text,
+  function_type& function)
+{
+  if (wavelet_tree == "WT_HUFF") {
+    withCsaWt<sdsl::wt_huff<>, sa_density>(text, function);
+  } else if (wavelet_tree == "WT_INT") {
+    withCsaWt<sdsl::wt_int<>, sa_density>(text, function);
+  } else if (wavelet_tree == "WT_BLCD") {
+    withCsaWt<sdsl::wt_blcd<>, sa_density>(text, function);
+  } else if (wavelet_tree == "WT_HUFF_RRR") {
+    withCsaWt<sdsl::wt_huff<sdsl::rrr_vector<63>>, sa_density>(text, function);
+  } else if (wavelet_tree == "RLBWT") {
+    RunLengthCsa csa(text, sa_density, 2*sa_density);
+    function(csa);
+  } else if (wavelet_tree == "PACKED") {
+    PackedCsa csa(text, sa_density, 2*sa_density);
+    function(csa);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+
+//! Checks whether a string names a CSA configuration.
+inline bool isCsaConfiguration(const std::string& configuration) {
+  const size_t colon = configuration.find(':');
+  const std::string wavelet_tree = configuration.substr(0, colon);
+  bool valid_wavelet_tree = false;
+  for (const std::string& name: CSA_WAVELET_TREES) {
+    valid_wavelet_tree |= wavelet_tree == name;
+  }
+  if (colon == std::string::npos) {
+    return valid_wavelet_tree;
+  }
+  bool valid_density = false;
+  for (const uint32_t& density: CSA_SAMPLE_DENSITIES) {
+    valid_density |= configuration.substr(colon+1) == std::to_string(density);
+  }
+  return valid_wavelet_tree && valid_density;
+}
+
+
+//! Constructs a CSA of a text with the given configuration and calls a
+//  function with it. The CSA only lives for the duration of the call, so the
+//  function is instantiated for every configuration, e.g. a generic lambda.
+/*!
+ *  \param configuration The name of the CSA configuration.
+ *  \param text The text.
+ *  \param function The function to call with the CSA.
+ *
+ *  \return Whether the configuration exists.
+ *
+ *  \throws std::invalid_argument If the configuration doesn't support the
+ *    text, i.e. PACKED and a text with more than 8 distinct characters.
+ */
+template <class function_type>
+bool withCsa(
+  const std::string& configuration,
+  const sdsl::int_vector<8>& text,
+  function_type&& function)
+{
+  if (!isCsaConfiguration(configuration)) {
+    return false;
+  }
+  const size_t colon = configuration.find(':');
+  const std::string wavelet_tree = configuration.substr(0, colon);
+  const std::string density =
+    colon == std::string::npos ? "32" : configuration.substr(colon+1);
+  if (density == "8") {
+    return withSampledCsa<8>(wavelet_tree, text, function);
+  } else if (density == "32") {
+    return withSampledCsa<32>(wavelet_tree, text, function);
+  }
+  return withSampledCsa<128>(wavelet_tree, text, function);
+}
+
+
+}
+
+#endif
@@ -55,7 +55,7 @@ public:
   //! Gets the ID for the given LCP-interval. IDs are assigned based on the end
   //  position of the first CSA entry in the interval.
   id_type
-  getId(const size_type& value, const size_type& begin, const size_type& end)
+  getId(const size_type& value, const size_type& begin, const size_type&)
   {
     size_type first_position = _csa[begin] + value;
     if (!_repeat_ids.contains(first_position)) {
@@ -68,7 +68,7 @@ public:
   //! Removes the ID for the given LCP-interval. Actually removes the position
   //  the interval's ID is based on from the position-ID map.
   void
-  removeId(const size_type& value, const size_type& begin, const size_type& end)
+  removeId(const size_type& value, const size_type& begin, const size_type&)
   {
     size_type first_position = _csa[begin] + value;
     if (_repeat_ids.contains(first_position)) {
@@ -0,0 +1,213 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDED_MR_CFG_INSTRUMENT
+#define INCLUDED_MR_CFG_INSTRUMENT
+
+#include <atomic>
+#include <bit>  // bit_width
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "mr-cfg/interval.hpp"
+
+
+namespace mr_cfg {
+
+
+//! A histogram of latencies with one bucket per power of two nanoseconds.
+//  Latencies can be added by several threads at once.
+class LatencyHistogram
+{
+
+private:
+
+  // bucket k counts latencies in [2^(k-1), 2^k) nanoseconds; bucket 0 counts 0
+  std::atomic<uint64_t> _buckets[65] = {};
+
+public:
+
+  //! Adds a latency to the histogram.
+  void add(const uint64_t& nanoseconds) {
+    _buckets[std::bit_width(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  //! Prints the non-empty buckets of the histogram.
+  /*!
+   *  \param out The stream to print to.
+   *  \param name The name of the operation whose latencies were measured.
+   */
+  void print(std::ostream& out, const std::string& name) const {
+    for (int k = 0; k < 65; ++k) {
+      const uint64_t count = _buckets[k].load();
+      if (count == 0) {
+        continue;
+      }
+      const uint64_t low = k == 0 ? 0 : uint64_t(1) << (k-1);
+      out << "\t" << name << " latency [" << low << ", " << (low == 0 ? 1 : 2*low)
+          << ")ns: " << count << std::endl;
+    }
+  }
+
+};
+
+
+//! An interval stabbing data-structure that counts the operations performed on
+//  another interval stabbing data-structure and samples their latencies.
+//  The counts are atomic, so a concurrent data-structure can be stabbed
+//  through the decorator by several threads at once.
+//
+//  Grammar construction only uses this decorator when compiled with
+//  MR_CFG_INSTRUMENT defined, so instrumentation costs nothing otherwise. The
+//  decorated data-structure's own event counts, e.g. FAST's container
+//  searches, are only counted and printed when it's defined too.
+template <typename element_type, typename position_type = uint64_t>
+class InstrumentedNestedIntervalStabber:
+  public NestedIntervalStabber<element_type, position_type>
+{
+
+private:
+
+  // the latency of one in this many operations is measured
+  static constexpr uint64_t SAMPLE_RATE = 64;
+
+  typedef std::chrono::steady_clock clock;
+
+  NestedIntervalStabber<element_type, position_type>& _intervals;
+  std::atomic<uint64_t> _stabs = 0;
+  std::atomic<uint64_t> _updates = 0;
+  std::atomic<uint64_t> _hits = 0;
+  std::atomic<uint64_t> _nulls = 0;
+  LatencyHistogram _stab_latencies;
+  LatencyHistogram _update_latencies;
+
+  static uint64_t _elapsed(const clock::time_point& start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      clock::now() - start).count();
+  }
+
+  //! Counts an operation.
+  /*!
+   *  \param counter The operation's counter.
+   *  \param count The number of operations.
+   *
+   *  \return The number of operations counted before these.
+   */
+  static uint64_t _count(std::atomic<uint64_t>& counter, uint64_t count = 1) {
+    return counter.fetch_add(count, std::memory_order_relaxed);
+  }
+
+public:
+
+  InstrumentedNestedIntervalStabber(
+    NestedIntervalStabber<element_type, position_type>& intervals):
+    _intervals(intervals) { }
+
+  const element_type* stab(const position_type& i) {
+    const element_type* id;
+    if (_count(_stabs) % SAMPLE_RATE == 0) {
+      const clock::time_point start = clock::now();
+      id = _intervals.stab(i);
+      _stab_latencies.add(_elapsed(start));
+    } else {
+      id = _intervals.stab(i);
+    }
+    _count(id == NULL ? _nulls : _hits);
+    return id;
+  }
+
+  //! Performs stabbing queries with the decorated data-structure's stabMany.
+  //  Sampled latencies are the average latency of the batch's queries.
+  void stabMany(
+    const std::vector<position_type>& positions,
+    std::vector<const element_type*>& out)
+  {
+    if (positions.empty()) {
+      return _intervals.stabMany(positions, out);
+    }
+    if (_count(_stabs, positions.size()) % SAMPLE_RATE < positions.size()) {
+      const clock::time_point start = clock::now();
+      _intervals.stabMany(positions, out);
+      _stab_latencies.add(_elapsed(start) / positions.size());
+    } else {
+      _intervals.stabMany(positions, out);
+    }
+    uint64_t nulls = 0;
+    for (const element_type* id: out) {
+      nulls += id == NULL;
+    }
+    _count(_nulls, nulls);
+    _count(_hits, out.size() - nulls);
+  }
+
+  void update(const position_type& begin, const position_type& end, const element_type& id) {
+    if (_count(_updates) % SAMPLE_RATE == 0) {
+      const clock::time_point start = clock::now();
+      _intervals.update(begin, end, id);
+      _update_latencies.add(_elapsed(start));
+    } else {
+      _intervals.update(begin, end, id);
+    }
+  }
+
+  void boundaries(
+    std::vector<position_type>& positions,
+    std::vector<const element_type*>& ids) const
+  {
+    _intervals.boundaries(positions, ids);
+  }
+
+  void publish() {
+    _intervals.publish();
+  }
+
+#ifdef MR_CFG_INSTRUMENT
+  void printCounters(std::ostream& out, const std::string& prefix) const {
+    _intervals.printCounters(out, prefix);
+  }
+#endif
+
+  //! Prints the operation counts and latency histograms, and, when compiled
+  //  with MR_CFG_INSTRUMENT defined, the decorated data-structure's event
+  //  counts.
+  /*!
+   *  \param out The stream to print to.
+   *  \param prefix A prefix for the names of the counts, e.g. to tell
+   *    reports on different data-structures apart.
+   */
+  void print(std::ostream& out, const std::string& prefix = "") const {
+    out << "\t" << prefix << "stabs: " << _stabs.load() << std::endl;
+    out << "\t" << prefix << "stab hits: " << _hits.load() << std::endl;
+    out << "\t" << prefix << "stab NULLs: " << _nulls.load() << std::endl;
+    out << "\t" << prefix << "updates: " << _updates.load() << std::endl;
+    out << "\t" << prefix << "latencies sampled every " << SAMPLE_RATE
+        << " operations" << std::endl;
+    _stab_latencies.print(out, prefix + "stab");
+    _update_latencies.print(out, prefix + "update");
+#ifdef MR_CFG_INSTRUMENT
+    printCounters(out, prefix);
+#endif
+  }
+
+};
+
+
+}
+
+#endif
@@ -17,27 +17,165 @@
 #ifndef INCLUDED_MR_CFG_INTERVAL
 #define INCLUDED_MR_CFG_INTERVAL
 
+#include <algorithm>  // lower_bound, max, min, upper_bound
+#include <atomic>
+#include <deque>
 #include <limits>
 #include <map>
+#include <memory>  // shared_ptr, unique_ptr
+#include <ostream>
 #include <stack>
+#include <stdexcept>  // logic_error
+#include <string>
+#include <thread>  // yield
 #include <unordered_map>
 #include <vector>
 
-#include <roaring/roaring64map.hh>
 #include <sdsl/bit_vectors.hpp>
+#include <sdsl/int_vector.hpp>
 #include <sdsl/rank_support_v.hpp>
-#include <sdsl/select_support_mcl.hpp>
+#include <sdsl/sd_vector.hpp>
 
 #include "mr-cfg/interval.hpp"
 #include "mr-cfg/lcp.hpp"
+#include "mr-cfg/record.hpp"
 
 
 namespace mr_cfg {
 
 
+//! A bit vector that supports successor queries using a hierarchy of summary
+//  words: each bit of a level's word is set if the corresponding word of the
+//  level below is non-zero. The top level is a single word, so a vector of m
+//  bits has O(\log_{64} m) levels.
+class SuccessorBitVector
+{
+
+private:
+
+  // the levels from the bits up; level l+1 has a bit per word of level l
+  std::vector<std::vector<uint64_t>> _levels;
+
+public:
+
+  SuccessorBitVector() = default;
+
+  //! Creates a vector of unset bits.
+  /*!
+   *  \param size The number of bits.
+   */
+  explicit SuccessorBitVector(uint64_t size) {
+    do {
+      size = (size + 63) / 64;
+      _levels.emplace_back(std::max<uint64_t>(size, 1), 0);
+    } while (size > 1);
+  }
+
+  //! Sets a bit and the summary bits of its words.
+  //
+  //  O(\log_{64} m) time, where m is the number of bits.
+  void add(uint64_t i) {
+    for (std::vector<uint64_t>& words: _levels) {
+      uint64_t& word = words[i >> 6];
+      const bool summarized = word != 0;
+      word |= uint64_t(1) << (i & 63);
+      // the levels above already summarize a non-zero word
+      if (summarized) {
+        break;
+      }
+      i >>= 6;
+    }
+  }
+
+  //! Gets the least set bit that isn't less than the given bit.
+  //
+  //  O(\log_{64} m) time, where m is the number of bits.
+  /*!
+   *  \param first The bit to start from.
+   *  \param bit Where to output the set bit.
+   *
+   *  \return Whether there is such a bit.
+   */
+  bool next(const uint64_t& first, uint64_t& bit) const {
+    // ascend until a word has a set bit at or after the current bit
+    uint64_t i = first;
+    size_t l = 0;
+    for (;; ++l) {
+      if (l == _levels.size() || (i >> 6) >= _levels[l].size()) {
+        return false;
+      }
+      const uint64_t word = _levels[l][i >> 6] & (~uint64_t(0) << (i & 63));
+      if (word != 0) {
+        i = (i & ~uint64_t(63)) + __builtin_ctzll(word);
+        break;
+      }
+      // continue from the next word
+      i = (i >> 6) + 1;
+    }
+    // descend to the least set bit of each summarized word
+    while (l-- > 0) {
+      i = (i << 6) + __builtin_ctzll(_levels[l][i]);
+    }
+    bit = i;
+    return true;
+  }
+
+};
+
+
+// the number of queries whose memory accesses stabMany overlaps
+constexpr size_t STAB_BATCH_SIZE = 8;
+
+
+//! Counts an internal event of an interval stabbing data-structure, e.g. a
+//  search of one of its levels. Events are only counted when compiled with
+//  MR_CFG_INSTRUMENT defined; otherwise adding to a counter does nothing. The
+//  count is atomic so queries made by several threads at once can be counted.
+class EventCounter
+{
+
+#ifdef MR_CFG_INSTRUMENT
+private:
+
+  mutable std::atomic<uint64_t> _count = 0;
+
+public:
+
+  EventCounter() = default;
+
+  EventCounter(const EventCounter& other): _count(other.load()) { }
+
+  EventCounter& operator=(const EventCounter& other) {
+    _count = other.load();
+    return *this;
+  }
+
+  void add(uint64_t count = 1) const {
+    _count.fetch_add(count, std::memory_order_relaxed);
+  }
+
+  uint64_t load() const {
+    return _count.load(std::memory_order_relaxed);
+  }
+#else
+public:
+
+  void add(uint64_t = 1) const { }
+
+  uint64_t load() const {
+    return 0;
+  }
+#endif
+
+};
+
+
 //! An abstract class that defines the interface of our novel data-structure for
 //  answering stabbing queries on nested intervals over a finite range [0..n].
-template <typename element_type>
+//
+//  The position type determines the width of the positions stored internally;
+//  uint32_t should be used whenever n < 2^32.
+template <typename element_type, typename position_type = uint64_t>
 class NestedIntervalStabber
 {
 
@@ -54,7 +192,26 @@ public:
    *
    *  \return A pointer to the ID of the interval stabbed, if any. Otherwise NULL.
    */
-  virtual const element_type* stab(const uint64_t& i) = 0;
+  virtual const element_type* stab(const position_type& i) = 0;
+
+  //! Performs a stabbing query for each of the given points. The queries are
+  //  independent so implementations can overlap their memory accesses, e.g.
+  //  by prefetching for several queries before resolving any of them. By
+  //  default the queries are performed one at a time.
+  /*!
+   *  \param positions The points to stab.
+   *  \param out The results of the stabbing queries, in the same order as the
+   *    points.
+   */
+  virtual void stabMany(
+    const std::vector<position_type>& positions,
+    std::vector<const element_type*>& out)
+  {
+    out.resize(positions.size());
+    for (size_t k = 0; k < positions.size(); ++k) {
+      out[k] = stab(positions[k]);
+    }
+  }
 
   //! Adds an interval so it can be returned by a stabbing query.
   /*!
@@ -63,7 +220,36 @@ public:
    *  \param id The ID of the interval to update.
    */
   virtual void
-  update(const uint64_t& begin, const uint64_t& end, const element_type& id) = 0;
+  update(const position_type& begin, const position_type& end, const element_type& id) = 0;
+
+  //! Gets the positions at which the results of stabbing queries may change
+  //  along with the result of stabbing each of them. A stabbing query on a
+  //  position returns the result of the last boundary that isn't greater than
+  //  it, or NULL if there is no such boundary.
+  /*!
+   *  \param positions The boundary positions in increasing order.
+   *  \param ids The result of stabbing each boundary position.
+   */
+  virtual void boundaries(
+    std::vector<position_type>& positions,
+    std::vector<const element_type*>& ids) const = 0;
+
+  //! Makes the updates made so far visible to stabbing queries made by other
+  //  threads. Only concurrent implementations defer updates until they're
+  //  published, so by default this does nothing.
+  virtual void publish() { }
+
+#ifdef MR_CFG_INSTRUMENT
+  //! Prints the counts of the implementation's internal events, e.g. which
+  //  containers its stabbing queries searched. By default there are none.
+  /*!
+   *  \param out The stream to print to.
+   *  \param prefix A prefix for the names of the counts.
+   */
+  virtual void printCounters(std::ostream&, const std::string&) const { }
+#endif
+
+  virtual ~NestedIntervalStabber() = default;
 
 };
 
@@ -71,18 +257,19 @@ public:
 //! An implementation of our novel interval stabbing data-structure that uses a
 //  sorted map and binary search. This is the "online" algorithm described in
 //  the paper.
-template <typename element_type>
-class OnlineNestedIntervalStabber: public NestedIntervalStabber<element_type>
+template <typename element_type, typename position_type = uint64_t>
+class OnlineNestedIntervalStabber:
+  public NestedIntervalStabber<element_type, position_type>
 {
 
 private:
 
   // maps selected bits to interval IDs
-  std::map<uint64_t, element_type> _lookup;
+  std::map<position_type, element_type> _lookup;
 
 public:
 
-  const element_type* stab(const uint64_t& i) {
+  const element_type* stab(const position_type& i) {
     // return NULL if the map is empty
     if (_lookup.empty()) {
       return NULL;
@@ -106,7 +293,7 @@ public:
   }
 
   //! Adds an interval assuming it's nested in an existing interval if there's any overlap.
-  void update(const uint64_t& begin, const uint64_t& end, const element_type& id) {
+  void update(const position_type& begin, const position_type& end, const element_type& id) {
     // get the ID of the interval this interval will be nested in
     const element_type* parent_id = stab(begin);
     // if the end bit is already set then:
@@ -123,6 +310,22 @@ public:
     _lookup[begin] = id;
   }
 
+  void boundaries(
+    std::vector<position_type>& positions,
+    std::vector<const element_type*>& ids) const
+  {
+    positions.clear();
+    ids.clear();
+    for (const auto& [position, id]: _lookup) {
+      positions.push_back(position);
+      if (id == std::numeric_limits<element_type>::max()) {
+        ids.push_back(NULL);
+      } else {
+        ids.push_back(&id);
+      }
+    }
+  }
+
 };
 
 
@@ -148,32 +351,173 @@ public:
 //  we use compressed bit vectors that utilize bit-level operations supported by
 //  the CPU, allowing large, sparse IDs to be stored in small space with near
 //  optimal run-time performance.
+//
+//  By default, bits are assigned to intervals in the reverse of a preorder of
+//  the interval tree that visits the child with the largest subtree first.
+//  The intervals of each heavy path then have consecutive bits and every
+//  root-to-interval path crosses O(\log m) heavy paths, so each ID consists of
+//  O(\log m) runs, where m is the number of maximal repeats. IDs are stored
+//  as their runs of consecutive bits in a single pool of bit-compressed
+//  integers, so preprocessing makes no per-repeat allocations and IDs take
+//  O(m\log^2 m) bits in total even when intervals are deeply nested.
+//  The bits of updated intervals are kept in a SuccessorBitVector, so a
+//  stabbing query takes O(\log_{64} m) time per run of the stabbed ID.
 template <typename element_type,
           class csa_wt,
+          typename position_type = uint64_t,
           typename value_type = typename csa_wt::wavelet_tree_type::value_type,
           typename size_type = typename csa_wt::size_type>
-class OptimalNestedIntervalStabber: public NestedIntervalStabber<element_type>
+class OptimalNestedIntervalStabber:
+  public NestedIntervalStabber<element_type, position_type>
 {
 
 private:
 
-  // maps selected bits to binary IDs
-  std::unordered_map<size_type, roaring::Roaring64Map*> _lookup;
+  // maps the rank of each set bit to the preorder index of the deepest
+  // interval that set it; _num_repeats means there's no interval
+  sdsl::int_vector<> _lookup;
   // stores the begin and end+1 positions of intervals
   sdsl::bit_vector _position_bits;
   // supports O(1) time rank queries on _position bits
   sdsl::rank_support_v5<> _rank;
-  // supports O(1) time select queries on _position_bits
-  sdsl::select_support_mcl<> _select;
   // the ID that tracks what intervals have been updated
-  roaring::Roaring64Map* _update_id;
-  // an array to store repeat IDs
-  roaring::Roaring64Map* *_ids;
-  // maps binary IDs to external IDs
-  std::unordered_map<uint32_t, element_type> _id_map;
-
-  //! Initializes data-structures by computing LCP-intervals for the given
-  //  compressed suffix array (CSA) then iterating them in begin-end order. An
+  SuccessorBitVector _update_id;
+  // the number of maximal repeat LCP-intervals
+  size_type _num_repeats;
+  // the binary ID of each interval, in preorder, as runs of consecutive bits:
+  // the runs of the pth ID are the {first bit, last bit} pairs
+  // _id_runs[2*_id_offsets[p]..2*_id_offsets[p+1]) in increasing order
+  sdsl::int_vector<> _id_offsets;
+  sdsl::int_vector<> _id_runs;
+  // maps interval bits to external IDs; the placeholder value means NULL
+  std::vector<element_type> _id_map;
+  // the successor queries made to find updated ancestors
+  EventCounter _successor_queries;
+
+  //! Assigns bits to intervals in reverse preorder.
+  /*!
+   *  \param parents The preorder index of the parent of each interval, in
+   *    preorder; the number of intervals means there's no parent.
+   *
+   *  \return The bit of each interval, in preorder.
+   */
+  static sdsl::int_vector<> _preorderBits(const sdsl::int_vector<>& parents) {
+    const size_type m = parents.size();
+    sdsl::int_vector<> bits(m, 0, parents.width());
+    for (size_type p = 0; p < m; ++p) {
+      bits[p] = m-1-p;
+    }
+    return bits;
+  }
+
+  //! Assigns bits to intervals in the reverse of a heavy-child-first preorder.
+  /*!
+   *  \param parents The preorder index of the parent of each interval, in
+   *    preorder; the number of intervals means there's no parent.
+   *
+   *  \return The bit of each interval, in preorder.
+   */
+  static sdsl::int_vector<> _heavyPathBits(const sdsl::int_vector<>& parents) {
+    const size_type m = parents.size();
+    const uint8_t width = parents.width();
+    // compute subtree sizes; children come after their parents in preorder
+    sdsl::int_vector<> sizes(m, 1, width);
+    for (size_type p = m; p-- > 0;) {
+      if (parents[p] != m) {
+        sizes[parents[p]] += sizes[p];
+      }
+    }
+    // find the child with the largest subtree of each interval
+    sdsl::int_vector<> heavy(m, m, width);
+    for (size_type p = 0; p < m; ++p) {
+      const size_type v = parents[p];
+      if (v != m && (heavy[v] == m || sizes[p] > sizes[heavy[v]])) {
+        heavy[v] = p;
+      }
+    }
+    // number the intervals in heavy-child-first preorder; the heavy child
+    // directly follows its parent and the light children follow the heavy
+    // child's subtree in their original order
+    sdsl::int_vector<> bits(m, 0, width);
+    sdsl::int_vector<> next(m, 0, width);  // next number for light children
+    size_type next_root = 0;
+    for (size_type p = 0; p < m; ++p) {
+      const size_type v = parents[p];
+      if (v == m) {
+        bits[p] = next_root;
+        next_root += sizes[p];
+      } else if (heavy[v] == p) {
+        bits[p] = bits[v] + 1;
+      } else {
+        bits[p] = next[v];
+        next[v] += sizes[p];
+      }
+      next[p] = bits[p] + 1;
+      if (heavy[p] != m) {
+        next[p] += sizes[heavy[p]];
+      }
+    }
+    // reverse the order so children have smaller bits than their parents
+    for (size_type p = 0; p < m; ++p) {
+      bits[p] = m-1-bits[p];
+    }
+    return bits;
+  }
+
+  //! Computes the run-length encoded binary ID of each interval. An ID
+  //  contains its interval's bit and its parent's ID, so it's its parent's
+  //  runs, with the first run extended if the interval's bit directly
+  //  precedes its parent's, e.g. if it's a heavy child, and otherwise with a
+  //  new first run.
+  /*!
+   *  \param parents The preorder index of the parent of each interval, in
+   *    preorder; the number of intervals means there's no parent.
+   *  \param bits The bit of each interval, in preorder.
+   */
+  void _computeIds(
+    const sdsl::int_vector<>& parents,
+    const sdsl::int_vector<>& bits)
+  {
+    const size_type m = parents.size();
+    // count the runs of each ID to compute the offsets
+    _id_offsets = sdsl::int_vector<>(m + 1, 0, 64);
+    for (size_type p = 0; p < m; ++p) {
+      const size_type v = parents[p];
+      size_type num_runs = 1;
+      if (v != m) {
+        num_runs = _id_offsets[v+1] - _id_offsets[v];
+        if (bits[p] + 1 != bits[v]) {
+          num_runs += 1;
+        }
+      }
+      _id_offsets[p+1] = _id_offsets[p] + num_runs;
+    }
+    // copy the parents' runs; parents come before their children in preorder
+    _id_runs = sdsl::int_vector<>(
+      2 * _id_offsets[m], 0, sdsl::bits::hi(std::max<size_type>(m, 1)) + 1);
+    for (size_type p = 0; p < m; ++p) {
+      const size_type v = parents[p];
+      size_type k = 2 * _id_offsets[p];
+      _id_runs[k] = bits[p];
+      if (v == m) {
+        _id_runs[k+1] = bits[p];
+        continue;
+      }
+      size_type j = 2 * _id_offsets[v];
+      if (bits[p] + 1 == bits[v]) {
+        j += 1;
+      } else {
+        _id_runs[++k] = bits[p];
+      }
+      for (k += 1; j < 2 * _id_offsets[v+1]; ++j, ++k) {
+        _id_runs[k] = _id_runs[j];
+      }
+    }
+    sdsl::util::bit_compress(_id_offsets);
+  }
+
+  //! Initializes data-structures from the maximal repeat LCP-intervals of a
+  //  compressed suffix array (CSA) by iterating them in begin-end order. An
   //  ID is assigned to each maximal repeat LCP-interval that reflects what
   //  other intervals it's nested in. Note that computing these IDs internally
   //  and mapping them to external IDs is not space optimal. We use this
@@ -182,59 +526,75 @@ private:
   //
   //  O(n) time, where n is the size of the CSA.
   /*!
-   *  \param csa The compressed suffix array to compute LCP-intervals for.
+   *  \param record The recorded maximal repeat LCP-intervals of the CSA.
+   *  \param heavy_path Whether to assign bits by heavy path rather than by
+   *    preorder.
    */
-  void initialize(const csa_wt& csa) {
+  void initialize(const MaximalIntervalRecord<csa_wt>& record, bool heavy_path) {
 
-    const size_type n = csa.size();
+    const size_type n = record.csaSize();
 
     // initialize the bit vector
     _position_bits = sdsl::bit_vector(n, 0);
 
-    // prepare to compute LCP-intervals
-    std::vector<size_type> interval;  // {LCP-value, begin, end}
-    bool loc_max;
-    auto lcp_intervals = lcp_interval_generator(csa, interval, loc_max);
+    // set the maximal repeats' bits
+    size_type num_repeats = record.size();
+    size_type num_bits = 0;
+    for (size_type k = 0; k < record.size(); ++k) {
+      const size_type begin = record.begin(k);
+      // set the begin bit
+      if (_position_bits[begin] == 0) {
+        _position_bits[begin] = 1;
+        num_bits += 1;
+      }
+      // set the end bit
+      size_type end = record.end(k)+1;
+      if (end < n && _position_bits[end] == 0) {
+        _position_bits[end] = 1;
+        num_bits += 1;
+      }
+    }
 
-    // skip the length 0 LCP-interval
-    lcp_intervals.next();
+    // initialize rank structure; the lookup is indexed by rank
+    _rank = sdsl::rank_support_v5<>(&_position_bits);
 
-    // compute LCP-intervals while counting maximal repeats and binning their
-    // end positions by begin position
-    size_type num_repeats = 0;
-    size_type num_bits = 0;
-    std::unordered_map<size_type, std::list<size_type>> repeat_bins;
-    for (auto left_extensions: lcp_intervals) {
-      // check if the interval is maximal
-      if (*left_extensions > 1) {
-        // count the repeat
-        num_repeats += 1;
-        // set the begin bit
-        if (_position_bits[interval[1]] == 0) {
-          _position_bits[interval[1]] = 1;
-          num_bits += 1;
-        }
-        // set the end bit
-        size_type end = interval[2]+1;
-        if (end < n && _position_bits[end] == 0) {
-          _position_bits[end] = 1;
-          num_bits += 1;
-        }
-        // bin the interval
-        repeat_bins[interval[1]].push_back(interval[2]);
+    // bin the end positions by the rank of their begin bit with a stable
+    // counting sort; the ends binned for the rankth bit are
+    // bin_ends[bin_offsets[rank]..bin_offsets[rank+1])
+    sdsl::int_vector<> bin_offsets(
+      num_bits + 1, 0, sdsl::bits::hi(num_repeats) + 1);
+    for (size_type k = 0; k < record.size(); ++k) {
+      bin_offsets[_rank.rank(record.begin(k))+1] += 1;
+    }
+    for (size_type r = 0; r < num_bits; ++r) {
+      bin_offsets[r+1] += bin_offsets[r];
+    }
+    sdsl::int_vector<> bin_ends(num_repeats, 0, sdsl::bits::hi(n) + 1);
+    {
+      // the next free slot in each bin
+      sdsl::int_vector<> bin_next(bin_offsets);
+      for (size_type k = 0; k < record.size(); ++k) {
+        const size_type r = _rank.rank(record.begin(k));
+        bin_ends[bin_next[r]] = record.end(k);
+        bin_next[r] += 1;
       }
     }
 
-    // initialize the update ID and prepare to compute repeat IDs
-    _update_id = new roaring::Roaring64Map();
-    _ids = new roaring::Roaring64Map*[num_repeats];
-    num_repeats -= 1;
-    _lookup.reserve(num_bits);
+    // prepare to compute repeat IDs
+    _num_repeats = num_repeats;
+    _update_id = SuccessorBitVector(num_repeats);
+    _id_map.assign(num_repeats, std::numeric_limits<element_type>::max());
+    const size_type no_id = num_repeats;
+    _lookup = sdsl::int_vector<>(
+      num_bits, no_id, sdsl::bits::hi(num_repeats + 1) + 1);
 
-    // dovetail iterate begin and end positions in order
+    // dovetail iterate begin and end positions in order, numbering the
+    // intervals in preorder and recording their parents
+    sdsl::int_vector<> parents(num_repeats, no_id, _lookup.width());
+    size_type num_numbered = 0;
     std::stack<size_type> end_stack;
-    std::stack<roaring::Roaring64Map*> id_stack;
-    id_stack.push(_update_id);
+    std::stack<size_type> id_stack;
+    id_stack.push(no_id);
     // -1 because intervals don't start at the last position and end+1 is out
     // of bounds at the last position
     for (size_type i = 0; i < _position_bits.size()-1; ++i) {
@@ -242,170 +602,1179 @@ private:
       while (!end_stack.empty()) {
         if (end_stack.top() == i) {
           end_stack.pop();
-          // add the parent ID to _lookup
+          // add the parent ID to _lookup; this may be no_id, which
+          // overwrites the IDs of intervals popped before the parent
           id_stack.pop();
-          if (id_stack.size() > 1) {
-            _lookup[i+1] = id_stack.top();
-          }
+          _lookup[_rank.rank(i+1)] = id_stack.top();
         } else {
           break;
         }
       }
       // generate an ID for each interval that starts at i
-      if (repeat_bins.contains(i)) {
+      const size_type r = _rank.rank(i);
+      if (_position_bits[i] && bin_offsets[r] != bin_offsets[r+1]) {
         // iterate the binned end positions
-        for (const size_type& end: repeat_bins[i]) {
+        for (size_type k = bin_offsets[r]; k < bin_offsets[r+1]; ++k) {
           // add the end position to the stack
-          end_stack.push(end);
-          // compute an ID for the interval derived from the parent ID
-          _ids[num_repeats] = new roaring::Roaring64Map(*id_stack.top());
-          _ids[num_repeats]->add(num_repeats);
-          id_stack.push(_ids[num_repeats]);
-          num_repeats -= 1;
+          end_stack.push(bin_ends[k]);
+          // number the interval
+          parents[num_numbered] = id_stack.top();
+          id_stack.push(num_numbered);
+          num_numbered += 1;
         }
         // add the last computed (deepest) ID to _lookup
-        roaring::Roaring64Map* top = id_stack.top();
-        size_type max_size = _lookup.max_size();
-        _lookup[i] = top;
+        _lookup[r] = id_stack.top();
       }
     }
 
-    // initialize rank structure
-    _rank = sdsl::rank_support_v5<>(&_position_bits);
+    // assign each interval a bit; bits decrease from parents to children so
+    // the minimum bit of an intersection is its deepest interval
+    const sdsl::int_vector<> bits =
+      heavy_path ? _heavyPathBits(parents) : _preorderBits(parents);
 
-    // initialize select structure
-    _select = sdsl::select_support_mcl(&_position_bits);
+    // compute the IDs; the lookup stays indexed by preorder
+    _computeIds(parents, bits);
 
   }
 
-  //! Performs a stabbing query on the intervals and returns the binary ID of
-  //  the deepest nested interval stabbed.
-  const roaring::Roaring64Map* _stab(const uint64_t& i) const {
-    // get the rank, i.e. how many bits are set up to i
-    // +1 because SDSL rank is exclusive
-    size_type rank = _rank.rank(i+1);
+  //! Gets the preorder index of the deepest nested interval that set the
+  //  rankth bit, or _num_repeats if there is no such interval.
+  size_type _index(const size_type& rank) const {
     // rank 0 means there's no element to get
     if (rank == 0) {
+      return _num_repeats;
+    }
+    return _lookup[rank-1];
+  }
+
+  //! Performs a stabbing query on the intervals and returns the preorder
+  //  index of the deepest nested interval stabbed, or _num_repeats if none.
+  size_type _stab(const position_type& i) const {
+    // get the rank, i.e. how many bits are set up to i
+    // +1 because SDSL rank is exclusive
+    return _index(_rank.rank(i+1));
+  }
+
+  //! Gets the least updated bit that isn't less than the given bit.
+  /*!
+   *  \param first The bit to start from.
+   *  \param bit Where to output the updated bit.
+   *
+   *  \return Whether there is such a bit.
+   */
+  bool _nextUpdated(const uint64_t& first, uint64_t& bit) const {
+    _successor_queries.add();
+    return _update_id.next(first, bit);
+  }
+
+  //! Gets the external ID of the deepest updated interval that the interval
+  //  with the given preorder index is nested in, if any. Otherwise NULL.
+  const element_type* _ancestor(const size_type& p) const {
+    // _num_repeats means there's no element to get
+    if (p == _num_repeats) {
       return NULL;
     }
-    // get the position of the rankth bit
-    size_type j = _select.select(rank);
-    // lookup the deepest nested interval that set the bit
-    if (_lookup.contains(j)) {
-      return _lookup.at(j);
+    // the deepest ancestor that has been updated has the least updated bit in
+    // the ID's runs; runs are in increasing order so each run is only
+    // searched if the last updated bit found precedes it, which takes
+    // O(\log_{64} m) time
+    size_type k = _id_offsets[p];
+    const size_type end = _id_offsets[p+1];
+    uint64_t bit;
+    if (!_nextUpdated(_id_runs[2*k], bit)) {
+      return NULL;
+    }
+    for (; k < end; ++k) {
+      if (bit < _id_runs[2*k] && !_nextUpdated(_id_runs[2*k], bit)) {
+        return NULL;
+      }
+      if (bit <= _id_runs[2*k+1]) {
+        // return the external ID of the ancestor
+        const element_type* id = &_id_map[bit];
+        if (*id == std::numeric_limits<element_type>::max()) {
+          return NULL;
+        }
+        return id;
+      }
     }
     return NULL;
   }
 
+  //! Gets the least bit in the binary IDs of both intervals, i.e. the bit of
+  //  their lowest common ancestor, or _num_repeats if they have none.
+  size_type _commonBit(const size_type& p, const size_type& q) const {
+    size_type j = _id_offsets[p];
+    size_type k = _id_offsets[q];
+    // the runs of both IDs are merged in increasing order, so the first
+    // overlap contains the least common bit
+    while (j < _id_offsets[p+1] && k < _id_offsets[q+1]) {
+      const size_type first = std::max(_id_runs[2*j], _id_runs[2*k]);
+      const size_type last = std::min(_id_runs[2*j+1], _id_runs[2*k+1]);
+      if (first <= last) {
+        return first;
+      }
+      if (_id_runs[2*j+1] < _id_runs[2*k+1]) {
+        j += 1;
+      } else {
+        k += 1;
+      }
+    }
+    return _num_repeats;
+  }
+
 public:
 
-  OptimalNestedIntervalStabber(const csa_wt& csa) {
-    initialize(csa);
+  OptimalNestedIntervalStabber(const csa_wt& csa, bool heavy_path = true) {
+    initialize(MaximalIntervalRecord<csa_wt>(csa), heavy_path);
   }
 
-  ~OptimalNestedIntervalStabber() {
-    // deallocate the update pointer
-    _update_id = NULL;
-    delete _update_id;
-    // deallocate the ID array
-    delete [] _ids;
+  //! Constructs the data-structure from already recorded maximal repeat
+  //  LCP-intervals so the CSA's LCP-intervals needn't be computed again.
+  OptimalNestedIntervalStabber(
+    const MaximalIntervalRecord<csa_wt>& record,
+    bool heavy_path = true)
+  {
+    initialize(record, heavy_path);
   }
 
   //! Performs a stabbing query on the intervals and returns the deepest nested
   //  interval stabbed that has been updated.
-  const element_type* stab(const uint64_t& i) {
-    // get the binary ID of the deepest nested interval
-    const roaring::Roaring64Map* binary_id = _stab(i);
-    // NULL means there's no element to get
-    if (binary_id == NULL) {
-      return NULL;
-    }
-    // compute the deepest ancestor that has been updated
-    const roaring::Roaring64Map ancestor_id = *_update_id & *binary_id;
-    // return the external ID if the ancestor exists
-    const uint64_t interval_bit = ancestor_id.minimum();
-    if (_id_map.contains(interval_bit)) {
-      return &_id_map.at(interval_bit);
+  const element_type* stab(const position_type& i) {
+    return _ancestor(_stab(i));
+  }
+
+  //! Performs stabbing queries in batches. The bit vector words, lookup
+  //  entries, and binary IDs of all the queries in a batch are prefetched in
+  //  turn before any of the batch's queries are resolved.
+  void stabMany(
+    const std::vector<position_type>& positions,
+    std::vector<const element_type*>& out)
+  {
+    out.resize(positions.size());
+    size_type indices[STAB_BATCH_SIZE];
+    for (size_t b = 0; b < positions.size(); b += STAB_BATCH_SIZE) {
+      const size_t batch = std::min(STAB_BATCH_SIZE, positions.size()-b);
+      // prefetch the bit vector words the ranks are computed from
+      for (size_t k = 0; k < batch; ++k) {
+        __builtin_prefetch(_position_bits.data() + ((positions[b+k]+1) >> 6));
+      }
+      // compute the ranks and prefetch the lookup entries
+      for (size_t k = 0; k < batch; ++k) {
+        indices[k] = _rank.rank(positions[b+k]+1);
+        if (indices[k] > 0) {
+          __builtin_prefetch(
+            _lookup.data() + (((indices[k]-1) * _lookup.width()) >> 6));
+        }
+      }
+      // lookup the intervals and prefetch their binary ID offsets
+      for (size_t k = 0; k < batch; ++k) {
+        indices[k] = _index(indices[k]);
+        if (indices[k] < _num_repeats) {
+          __builtin_prefetch(
+            _id_offsets.data() + ((indices[k] * _id_offsets.width()) >> 6));
+        }
+      }
+      // resolve the queries
+      for (size_t k = 0; k < batch; ++k) {
+        out[b+k] = _ancestor(indices[k]);
+      }
     }
-    return NULL;
   }
 
   //! Assigns an ID to an interval already in the structure so it can be
-  //  returned by stabbing queries.
-  void update(const uint64_t& begin, const uint64_t& end, const element_type& id) {
-    // get the binary IDs of the deepest intervals the begin and end positions stab
-    const roaring::Roaring64Map* begin_id = _stab(begin);
-    const roaring::Roaring64Map* end_id = _stab(end);
-    // compute the lowest common ancestor ID, i.e. the ID originally assigned to
-    // the interval
-    const roaring::Roaring64Map interval_id = *begin_id & *end_id;
+  //  returned by stabbing queries. Intervals that aren't in the structure are
+  //  ignored.
+  void update(const position_type& begin, const position_type& end, const element_type& id) {
+    // get the deepest intervals the begin and end positions stab and compute
+    // their lowest common ancestor, i.e. the interval being updated; there's
+    // no such interval if a position isn't in any interval or the positions'
+    // intervals have no common ancestor
+    const size_type p = _stab(begin);
+    const size_type q = _stab(end);
+    if (p == _num_repeats || q == _num_repeats) {
+      return;
+    }
+    const size_type interval_bit = _commonBit(p, q);
+    if (interval_bit == _num_repeats) {
+      return;
+    }
     // save the ID mapping
-    //uint32_t interval_bit = interval_id.minimum();
-    const uint64_t interval_bit = interval_id.minimum();
     _id_map[interval_bit] = id;
-    // make the ID discoverable by stabbing queries
-    *_update_id |= interval_id;
+    // make the ID discoverable by stabbing queries; only the interval's bit is
+    // added since its ancestors may not have been updated
+    _update_id.add(interval_bit);
+  }
+
+#ifdef MR_CFG_INSTRUMENT
+  void printCounters(std::ostream& out, const std::string& prefix) const {
+    out << "\t" << prefix << "successor queries: "
+        << _successor_queries.load() << std::endl;
+  }
+#endif
+
+  //! Gets the set bits along with the deepest updated interval that each of
+  //  their binary IDs is nested in.
+  void boundaries(
+    std::vector<position_type>& positions,
+    std::vector<const element_type*>& ids) const
+  {
+    positions.clear();
+    ids.clear();
+    const uint64_t* words = _position_bits.data();
+    const size_type num_words = (_position_bits.size() + 63) / 64;
+    size_type rank = 0;
+    for (size_type w = 0; w < num_words; ++w) {
+      // iterate the word's set bits from least to most significant
+      for (uint64_t word = words[w]; word != 0; word &= word - 1) {
+        rank += 1;
+        positions.push_back(w*64 + __builtin_ctzll(word));
+        ids.push_back(_ancestor(_index(rank)));
+      }
+    }
   }
 
 };
 
 
 //! An implementation of our novel interval stabbing data-structure that uses a
-//  dynamic bitmap.
-template <typename element_type>
-class FastNestedIntervalStabber: public NestedIntervalStabber<element_type>
+//  dynamic compressed bitmap.
+//
+//  Like a Roaring bitmap, positions are partitioned into chunks by their high
+//  bits and each chunk stores the low bits of its positions in either a sorted
+//  array container or, once it holds too many positions, a bitmap container.
+//  Here each container also stores the IDs of its positions in the same order
+//  so the rank computed by a predecessor search indexes the ID directly,
+//  rather than requiring a select and a hash map lookup. A bitmap container
+//  keeps the IDs of each of its words separately, so adding a position only
+//  shifts the IDs of the positions in the same word.
+template <typename element_type, typename position_type = uint64_t>
+class FastNestedIntervalStabber:
+  public NestedIntervalStabber<element_type, position_type>
 {
 
 private:
 
-  // maps selected bits to interval IDs
-  std::unordered_map<uint64_t, element_type> _lookup;
-  // stores the begin and end+1 positions of intervals
-  roaring::Roaring64Map _position_bits;
+  // the number of low position bits stored in a chunk; a bitmap container
+  // has one word per 64 positions and a summary word with a bit per word
+  static constexpr unsigned CHUNK_BITS = 12;
+  static constexpr position_type CHUNK_MASK =
+    (static_cast<position_type>(1) << CHUNK_BITS) - 1;
+  static constexpr size_t CHUNK_WORDS = (size_t(1) << CHUNK_BITS) / 64;
+  // the most positions an array container holds; this bounds the cost of
+  // inserting into it, which shifts the positions and IDs after the position,
+  // and a bitmap container takes about as much space at this size
+  static constexpr size_t ARRAY_MAX_SIZE = 256;
+
+  //! The begin and end+1 positions of intervals that share their high bits.
+  struct Chunk
+  {
+    // the sorted low bits of the positions; empty in a bitmap container
+    std::vector<uint16_t> lows;
+    // the interval ID of each position; the placeholder value means NULL
+    std::vector<element_type> ids;
+    // the bitmap of the low bits; empty in an array container
+    std::vector<uint64_t> words;
+    // the bitmap's non-zero words
+    uint64_t summary = 0;
+    // the interval IDs of each word's positions in a bitmap container
+    std::vector<std::vector<element_type>> word_ids;
+  };
+
+  // the high bits of the chunks in sorted order
+  std::vector<position_type> _keys;
+  // the chunks in the same order as their keys
+  std::vector<Chunk> _chunks;
+  // the predecessor searches of each container type, including the searches
+  // updates make, and the chunks created and converted to bitmap containers
+  EventCounter _array_searches;
+  EventCounter _bitmap_searches;
+  EventCounter _chunks_created;
+  EventCounter _bitmaps_created;
+
+  //! Converts an array container into a bitmap container.
+  static void _toBitmap(Chunk& chunk) {
+    chunk.words.assign(CHUNK_WORDS, 0);
+    chunk.word_ids.resize(CHUNK_WORDS);
+    for (size_t k = 0; k < chunk.lows.size(); ++k) {
+      const uint16_t w = chunk.lows[k] >> 6;
+      chunk.words[w] |= uint64_t(1) << (chunk.lows[k] & 63);
+      chunk.summary |= uint64_t(1) << w;
+      chunk.word_ids[w].push_back(chunk.ids[k]);
+    }
+    std::vector<uint16_t>().swap(chunk.lows);
+    std::vector<element_type>().swap(chunk.ids);
+  }
+
+  //! Adds a position with the given ID. If the position is already present
+  //  then its ID is only changed if replace is true.
+  void _add(const position_type& i, const element_type& id, bool replace) {
+    // get the chunk the position belongs to, adding it if necessary
+    const position_type key = i >> CHUNK_BITS;
+    auto key_iter = std::lower_bound(_keys.begin(), _keys.end(), key);
+    auto chunk_iter = _chunks.begin() + (key_iter - _keys.begin());
+    if (key_iter == _keys.end() || *key_iter != key) {
+      _keys.insert(key_iter, key);
+      chunk_iter = _chunks.insert(chunk_iter, Chunk());
+      _chunks_created.add();
+    }
+    Chunk& chunk = *chunk_iter;
+    const uint16_t low = i & CHUNK_MASK;
+    // add the position and its ID to the bitmap container
+    if (!chunk.words.empty()) {
+      const uint16_t w = low >> 6;
+      const uint64_t bit = uint64_t(1) << (low & 63);
+      std::vector<element_type>& ids = chunk.word_ids[w];
+      auto id_iter = ids.begin() + __builtin_popcountll(chunk.words[w] & (bit-1));
+      if (chunk.words[w] & bit) {
+        if (replace) {
+          *id_iter = id;
+        }
+      } else {
+        chunk.words[w] |= bit;
+        chunk.summary |= uint64_t(1) << w;
+        ids.insert(id_iter, id);
+      }
+      return;
+    }
+    // add the position and its ID to the array container
+    std::vector<uint16_t>& lows = chunk.lows;
+    auto low_iter = std::lower_bound(lows.begin(), lows.end(), low);
+    auto id_iter = chunk.ids.begin() + (low_iter - lows.begin());
+    if (low_iter != lows.end() && *low_iter == low) {
+      if (replace) {
+        *id_iter = id;
+      }
+    } else {
+      lows.insert(low_iter, low);
+      chunk.ids.insert(id_iter, id);
+      if (lows.size() > ARRAY_MAX_SIZE) {
+        _toBitmap(chunk);
+        _bitmaps_created.add();
+      }
+    }
+  }
+
+  //! Gets the index of the last chunk whose key isn't greater than the
+  //  position's, or the number of chunks if there is no such chunk.
+  size_t _chunk(const position_type& i) const {
+    const position_type key = i >> CHUNK_BITS;
+    auto key_iter = std::upper_bound(_keys.begin(), _keys.end(), key);
+    if (key_iter == _keys.begin()) {
+      return _chunks.size();
+    }
+    return (key_iter - _keys.begin()) - 1;
+  }
+
+  //! Gets the ID of the last position in the given chunk that's up to i.
+  //  The ID may be the placeholder.
+  /*!
+   *  \return A pointer to the ID, or NULL if there is no such position in the
+   *    chunk or the previous chunk.
+   */
+  const element_type* _predecessor(const size_t& c, const position_type& i) const {
+    const Chunk& chunk = _chunks[c];
+    // every position in the chunk is less than i if the chunk's key is
+    const uint16_t low =
+      (_keys[c] != i >> CHUNK_BITS) ? CHUNK_MASK : (i & CHUNK_MASK);
+    if (!chunk.words.empty()) {
+      _bitmap_searches.add();
+      // look for the position in the word containing the low bits and then in
+      // the last preceding non-zero word
+      uint16_t w = low >> 6;
+      const unsigned b = low & 63;
+      uint64_t word = chunk.words[w];
+      if (b < 63) {
+        word &= (uint64_t(2) << b) - 1;
+      }
+      if (word == 0) {
+        const uint64_t preceding = chunk.summary & ((uint64_t(1) << w) - 1);
+        // the predecessor is in the previous chunk, if any
+        if (preceding == 0) {
+          return c > 0 ? _last(c-1) : NULL;
+        }
+        w = 63 - __builtin_clzll(preceding);
+        return &chunk.word_ids[w].back();
+      }
+      return &chunk.word_ids[w][__builtin_popcountll(word)-1];
+    }
+    _array_searches.add();
+    // get the rank, i.e. how many positions in the chunk are up to i
+    const std::vector<uint16_t>& lows = chunk.lows;
+    const size_t rank = std::upper_bound(lows.begin(), lows.end(), low) - lows.begin();
+    // rank 0 means the predecessor is in the previous chunk, if any
+    if (rank > 0) {
+      return &chunk.ids[rank-1];
+    }
+    return c > 0 ? _last(c-1) : NULL;
+  }
+
+  //! Gets the ID of the last position in the given chunk.
+  const element_type* _last(const size_t& c) const {
+    const Chunk& chunk = _chunks[c];
+    if (!chunk.words.empty()) {
+      return &chunk.word_ids[63 - __builtin_clzll(chunk.summary)].back();
+    }
+    return &chunk.ids.back();
+  }
+
+  //! Returns NULL if the ID is the placeholder. Otherwise the ID.
+  static const element_type* _id(const element_type* id) {
+    if (id == NULL || *id == std::numeric_limits<element_type>::max()) {
+      return NULL;
+    }
+    return id;
+  }
 
 public:
 
-  const element_type* stab(const uint64_t& i) {
-    // get the rank, i.e. how many bits are set up to i
-    uint64_t rank = _position_bits.rank(i);
-    // rank 0 means there's no element to get
-    if (rank == 0) {
+  const element_type* stab(const position_type& i) {
+    // get the chunk the position's predecessor is in
+    const size_t c = _chunk(i);
+    // return NULL if there is no such chunk
+    if (c == _chunks.size()) {
       return NULL;
     }
-    // get the position of the rankth bit
-    uint64_t j;
-    // -1 because roaring select is 0 based
-    bool has_bit = _position_bits.select(rank-1, &j);
-    // lookup the deepest nested interval that set the bit
-    if (has_bit && _lookup.contains(j)) {
-      return &_lookup[j];
+    return _id(_predecessor(c, i));
+  }
+
+  //! Performs stabbing queries in batches. The containers and then the IDs of
+  //  all the queries in a batch are prefetched before any of the batch's
+  //  queries are resolved.
+  void stabMany(
+    const std::vector<position_type>& positions,
+    std::vector<const element_type*>& out)
+  {
+    out.resize(positions.size());
+    size_t chunks[STAB_BATCH_SIZE];
+    const element_type* ids[STAB_BATCH_SIZE];
+    for (size_t b = 0; b < positions.size(); b += STAB_BATCH_SIZE) {
+      const size_t batch = std::min(STAB_BATCH_SIZE, positions.size()-b);
+      // get the chunks and prefetch the words of their bitmap containers or
+      // the middle of their array containers, where their binary searches
+      // start
+      for (size_t k = 0; k < batch; ++k) {
+        chunks[k] = _chunk(positions[b+k]);
+        if (chunks[k] < _chunks.size()) {
+          const Chunk& chunk = _chunks[chunks[k]];
+          if (!chunk.words.empty()) {
+            __builtin_prefetch(
+              chunk.words.data() + ((positions[b+k] & CHUNK_MASK) >> 6));
+          } else {
+            __builtin_prefetch(chunk.lows.data() + chunk.lows.size()/2);
+          }
+        }
+      }
+      // find the predecessors and prefetch their IDs
+      for (size_t k = 0; k < batch; ++k) {
+        ids[k] = NULL;
+        if (chunks[k] < _chunks.size()) {
+          ids[k] = _predecessor(chunks[k], positions[b+k]);
+          if (ids[k] != NULL) {
+            __builtin_prefetch(ids[k]);
+          }
+        }
+      }
+      // resolve the queries
+      for (size_t k = 0; k < batch; ++k) {
+        out[b+k] = _id(ids[k]);
+      }
     }
-    return NULL;
   }
 
   //! Adds an interval assuming it's nested in an existing interval if there's any overlap.
-  void update(const uint64_t& begin, const uint64_t& end, const element_type& id) {
-    // get the ID of the interval this interval will be nested in
+  void update(const position_type& begin, const position_type& end, const element_type& id) {
+    // get the ID of the interval this interval will be nested in; it's copied
+    // because adding positions moves the IDs stored after them
     const element_type* parent_id = stab(begin);
+    const element_type parent = (parent_id == NULL) ?
+      std::numeric_limits<element_type>::max() : *parent_id;
     // if the end bit is already set then:
     // 1) it's already set by another end and we don't want to update the lookup; or
     // 2) it's already set by a begin and we don't want to change it
-    if (!_position_bits.contains(end+1)) {
-      _position_bits.add(end+1);
-      // save space by only saving IDs that aren't NULL
-      if (parent_id != NULL) {
-        _lookup[end+1] = *parent_id;
+    _add(end+1, parent, false);
+    // add the beginning of the interval
+    _add(begin, id, true);
+  }
+
+  void boundaries(
+    std::vector<position_type>& positions,
+    std::vector<const element_type*>& ids) const
+  {
+    positions.clear();
+    ids.clear();
+    for (size_t c = 0; c < _chunks.size(); ++c) {
+      const Chunk& chunk = _chunks[c];
+      const position_type high = _keys[c] << CHUNK_BITS;
+      for (size_t k = 0; k < chunk.lows.size(); ++k) {
+        positions.push_back(high | chunk.lows[k]);
+        ids.push_back(_id(&chunk.ids[k]));
+      }
+      for (size_t w = 0; w < chunk.words.size(); ++w) {
+        // iterate the word's set bits from least to most significant
+        size_t k = 0;
+        for (uint64_t word = chunk.words[w]; word != 0; word &= word - 1, ++k) {
+          positions.push_back(high | (w*64 + __builtin_ctzll(word)));
+          ids.push_back(_id(&chunk.word_ids[w][k]));
+        }
       }
     }
-    // add the beginning of the interval here so we don't change parent_id's value before
-    // dereferencing
-    _position_bits.add(begin);
-    _lookup[begin] = id;
   }
 
+#ifdef MR_CFG_INSTRUMENT
+  void printCounters(std::ostream& out, const std::string& prefix) const {
+    out << "\t" << prefix << "array container searches: "
+        << _array_searches.load() << std::endl;
+    out << "\t" << prefix << "bitmap container searches: "
+        << _bitmap_searches.load() << std::endl;
+    out << "\t" << prefix << "chunks created: " << _chunks_created.load()
+        << std::endl;
+    out << "\t" << prefix << "array containers converted to bitmaps: "
+        << _bitmaps_created.load() << std::endl;
+  }
+#endif
+
+};
+
+
+//! Merges two sorted runs of positions and their IDs, e.g. the runs of
+//  LsmNestedIntervalStabber; positions in both runs keep the newer run's ID.
+/*!
+ *  \param newer The newer run.
+ *  \param older The older run.
+ *
+ *  \return The merged run.
+ */
+template <class run_type>
+run_type mergeRuns(const run_type& newer, const run_type& older) {
+  run_type merged;
+  merged.positions.reserve(newer.positions.size() + older.positions.size());
+  merged.ids.reserve(newer.ids.size() + older.ids.size());
+  size_t j = 0, k = 0;
+  while (j < newer.positions.size() || k < older.positions.size()) {
+    if (k == older.positions.size() ||
+        (j < newer.positions.size() && newer.positions[j] <= older.positions[k]))
+    {
+      if (k < older.positions.size() && newer.positions[j] == older.positions[k]) {
+        k += 1;
+      }
+      merged.positions.push_back(newer.positions[j]);
+      merged.ids.push_back(newer.ids[j]);
+      j += 1;
+    } else {
+      merged.positions.push_back(older.positions[k]);
+      merged.ids.push_back(older.ids[k]);
+      k += 1;
+    }
+  }
+  return merged;
+}
+
+
+//! An implementation of our novel interval stabbing data-structure that uses a
+//  log-structured merge (LSM) layout.
+//
+//  Updates are inserted into a small sorted buffer. When the buffer is full it
+//  is merged into a hierarchy of immutable sorted levels, each a constant
+//  factor larger than the previous, and a level that outgrows its capacity is
+//  merged into the next. Stabbing queries search the buffer and then the
+//  levels from newest to oldest, returning the greatest position not greater
+//  than the query; when components share that position the newest one wins.
+//  This keeps bursts of updates cheap while storing positions and IDs in flat
+//  arrays that are fast to search, rather than in std::map nodes.
+//
+//  The pointers returned by stabbing queries are invalidated by updates.
+template <typename element_type, typename position_type = uint64_t>
+class LsmNestedIntervalStabber:
+  public NestedIntervalStabber<element_type, position_type>
+{
+
+private:
+
+  // the capacity of the buffer
+  static constexpr size_t BUFFER_CAPACITY = 1024;
+  // the factor by which the capacity of each level exceeds the previous one's
+  static constexpr size_t LEVEL_RATIO = 8;
+
+  //! A sorted run of interval begin and end+1 positions.
+  struct Run
+  {
+    // the sorted positions
+    std::vector<position_type> positions;
+    // the ID of each position; the placeholder value means NULL
+    std::vector<element_type> ids;
+  };
+
+  // the newest positions
+  Run _buffer;
+  // immutable runs from newest to oldest
+  std::vector<Run> _levels;
+  // the runs stabbing queries searched, including the buffer and the searches
+  // updates make, and the buffer flushes and level merges
+  EventCounter _run_searches;
+  EventCounter _flushes;
+  EventCounter _merges;
+
+  //! Merges the buffer into the levels, cascading merges into older levels
+  //  while levels exceed their capacities.
+  void _flush() {
+    if (_levels.empty()) {
+      _levels.emplace_back();
+    }
+    _levels[0] = mergeRuns(_buffer, _levels[0]);
+    _buffer = Run();
+    _flushes.add();
+    size_t capacity = BUFFER_CAPACITY * LEVEL_RATIO;
+    for (size_t l = 0; l < _levels.size(); ++l, capacity *= LEVEL_RATIO) {
+      if (_levels[l].positions.size() <= capacity) {
+        break;
+      }
+      if (l+1 == _levels.size()) {
+        _levels.emplace_back();
+      }
+      _levels[l+1] = mergeRuns(_levels[l], _levels[l+1]);
+      _levels[l] = Run();
+      _merges.add();
+    }
+  }
+
+  //! Gets the index of the last position in the run that isn't greater than
+  //  i, or the size of the run if there is no such position.
+  static size_t _predecessor(const Run& run, const position_type& i) {
+    auto iter =
+      std::upper_bound(run.positions.begin(), run.positions.end(), i);
+    if (iter == run.positions.begin()) {
+      return run.positions.size();
+    }
+    return (iter - run.positions.begin()) - 1;
+  }
+
+  //! Checks if any run contains the position.
+  bool _contains(const position_type& i) const {
+    size_t k = _predecessor(_buffer, i);
+    if (k < _buffer.positions.size() && _buffer.positions[k] == i) {
+      return true;
+    }
+    for (const Run& level: _levels) {
+      k = _predecessor(level, i);
+      if (k < level.positions.size() && level.positions[k] == i) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  //! Adds a position with the given ID to the buffer, replacing the ID if the
+  //  position is already in the buffer.
+  void _add(const position_type& i, const element_type& id) {
+    auto iter =
+      std::lower_bound(_buffer.positions.begin(), _buffer.positions.end(), i);
+    auto id_iter = _buffer.ids.begin() + (iter - _buffer.positions.begin());
+    if (iter != _buffer.positions.end() && *iter == i) {
+      *id_iter = id;
+    } else {
+      _buffer.positions.insert(iter, i);
+      _buffer.ids.insert(id_iter, id);
+    }
+  }
+
+public:
+
+  const element_type* stab(const position_type& i) {
+    // find the greatest position not greater than i, searching from newest to
+    // oldest so the newest run wins ties
+    const element_type* id = NULL;
+    position_type best = 0;
+    size_t k = _predecessor(_buffer, i);
+    if (k < _buffer.positions.size()) {
+      best = _buffer.positions[k];
+      id = &_buffer.ids[k];
+    }
+    _run_searches.add(1 + _levels.size());
+    for (const Run& level: _levels) {
+      k = _predecessor(level, i);
+      if (k < level.positions.size() && (id == NULL || level.positions[k] > best)) {
+        best = level.positions[k];
+        id = &level.ids[k];
+      }
+    }
+    // return NULL if there's no position or its ID is the placeholder
+    if (id == NULL || *id == std::numeric_limits<element_type>::max()) {
+      return NULL;
+    }
+    return id;
+  }
+
+  //! Adds an interval assuming it's nested in an existing interval if there's any overlap.
+  void update(const position_type& begin, const position_type& end, const element_type& id) {
+    // get the ID of the interval this interval will be nested in; it's copied
+    // because adding positions moves the IDs stored after them
+    const element_type* parent_id = stab(begin);
+    const element_type parent = (parent_id == NULL) ?
+      std::numeric_limits<element_type>::max() : *parent_id;
+    // only add the end position if it isn't already set by another end or a
+    // begin
+    if (!_contains(end+1)) {
+      _add(end+1, parent);
+    }
+    // add the beginning of the interval
+    _add(begin, id);
+    if (_buffer.positions.size() >= BUFFER_CAPACITY) {
+      _flush();
+    }
+  }
+
+  void boundaries(
+    std::vector<position_type>& positions,
+    std::vector<const element_type*>& ids) const
+  {
+    positions.clear();
+    ids.clear();
+    // merge the runs, taking the ID of each position from the newest run that
+    // contains it
+    std::vector<const Run*> runs;
+    runs.push_back(&_buffer);
+    for (const Run& level: _levels) {
+      runs.push_back(&level);
+    }
+    std::vector<size_t> next(runs.size(), 0);
+    while (true) {
+      // get the least next position, preferring newer runs
+      size_t r = runs.size();
+      for (size_t l = 0; l < runs.size(); ++l) {
+        if (next[l] < runs[l]->positions.size() &&
+            (r == runs.size() ||
+             runs[l]->positions[next[l]] < runs[r]->positions[next[r]]))
+        {
+          r = l;
+        }
+      }
+      if (r == runs.size()) {
+        break;
+      }
+      const position_type position = runs[r]->positions[next[r]];
+      const element_type* id = &runs[r]->ids[next[r]];
+      positions.push_back(position);
+      ids.push_back(*id == std::numeric_limits<element_type>::max() ? NULL : id);
+      // skip the position in every run
+      for (size_t l = 0; l < runs.size(); ++l) {
+        if (next[l] < runs[l]->positions.size() &&
+            runs[l]->positions[next[l]] == position)
+        {
+          next[l] += 1;
+        }
+      }
+    }
+  }
+
+#ifdef MR_CFG_INSTRUMENT
+  void printCounters(std::ostream& out, const std::string& prefix) const {
+    out << "\t" << prefix << "runs searched: " << _run_searches.load()
+        << std::endl;
+    out << "\t" << prefix << "buffer flushes: " << _flushes.load()
+        << std::endl;
+    out << "\t" << prefix << "level merges: " << _merges.load() << std::endl;
+    out << "\t" << prefix << "levels: " << _levels.size() << std::endl;
+  }
+#endif
+
+};
+
+
+//! An implementation of our novel interval stabbing data-structure that
+//  supports many concurrent readers and a single writer.
+//
+//  The writer's updates are applied to a private sorted map, as in the online
+//  algorithm, and become visible to readers when the writer publishes them.
+//  The positions changed since the last publish are also kept in a delta, and
+//  publishing turns the delta into an immutable sorted run. A snapshot is the
+//  list of runs, which are shared with the previous snapshots rather than
+//  copied, and a run is merged with the next older one while the older one
+//  isn't more than twice as large, so a snapshot has O(log m) runs and each
+//  position is merged O(log m) times, where m is the number of intervals.
+//  Stabbing queries search the runs, as in the LSM algorithm, returning the
+//  greatest position not greater than the query; when runs share that
+//  position the newest one wins.
+//
+//  Publishing swaps the new snapshot in atomically, so readers never lock and
+//  always stab a consistent set of intervals. Snapshots are reclaimed using
+//  two reader epochs: readers register in the current epoch before loading
+//  the snapshot, and after swapping in a new snapshot the writer advances the
+//  epoch and waits for the readers of the previous epoch to finish twice, once
+//  for each epoch parity, before freeing the old snapshot. Advancing the epoch
+//  first means new readers register in the other parity, so the writer can't
+//  be starved. Only the writer copies or frees the pointers to runs.
+//
+//  IDs are stored in an append-only deque that's shared by every snapshot, so
+//  the pointers returned by stabbing queries remain valid for the lifetime of
+//  the data-structure.
+template <typename element_type, typename position_type = uint64_t>
+class ConcurrentNestedIntervalStabber:
+  public NestedIntervalStabber<element_type, position_type>
+{
+
+private:
+
+  //! An immutable sorted run of interval begin and end+1 positions.
+  struct Run
+  {
+    // the sorted positions
+    std::vector<position_type> positions;
+    // the ID of each position; NULL means no ID
+    std::vector<const element_type*> ids;
+  };
+
+  //! The published runs.
+  struct Snapshot
+  {
+    // the runs from oldest to newest
+    std::vector<std::shared_ptr<const Run>> runs;
+  };
+
+  // the writer's map from selected bits to interval IDs
+  std::map<position_type, const element_type*> _lookup;
+  // the writer's updates to the map since the last publish
+  std::map<position_type, const element_type*> _delta;
+  // stores every ID the writer has been given; deque elements don't move as
+  // the deque grows
+  std::deque<element_type> _ids;
+  // the snapshot stabbing queries are performed on
+  std::atomic<const Snapshot*> _snapshot;
+  // the current reader epoch
+  std::atomic<uint64_t> _epoch;
+  // the number of readers registered in even and odd epochs
+  std::atomic<uint64_t> _readers[2];
+  // the runs stabbing queries searched, and the publishes, the run merges
+  // they made, and the times they yielded while waiting for readers
+  EventCounter _run_searches;
+  EventCounter _publishes;
+  EventCounter _merges;
+  EventCounter _reader_waits;
+
+  //! Performs a stabbing query on the writer's map.
+  const element_type* _stab(const position_type& i) const {
+    // get the first element with a key that is greater than i
+    auto iter = _lookup.upper_bound(i);
+    // return NULL if there is no element up to i
+    if (iter == _lookup.begin()) {
+      return NULL;
+    }
+    return std::prev(iter)->second;
+  }
+
+  //! Performs a stabbing query on a snapshot.
+  static const element_type*
+  _stab(const Snapshot* snapshot, const position_type& i) {
+    // find the greatest position not greater than i, searching from newest to
+    // oldest so the newest run wins ties
+    const element_type* id = NULL;
+    position_type best = 0;
+    bool found = false;
+    for (size_t r = snapshot->runs.size(); r-- > 0;) {
+      const std::vector<position_type>& positions = snapshot->runs[r]->positions;
+      auto iter = std::upper_bound(positions.begin(), positions.end(), i);
+      if (iter == positions.begin()) {
+        continue;
+      }
+      const size_t k = (iter - positions.begin()) - 1;
+      if (!found || positions[k] > best) {
+        best = positions[k];
+        id = snapshot->runs[r]->ids[k];
+        found = true;
+      }
+    }
+    return id;
+  }
+
+  //! Sets the ID of a position in the writer's map and delta.
+  void _set(const position_type& i, const element_type* id) {
+    _lookup[i] = id;
+    _delta[i] = id;
+  }
+
+public:
+
+  ConcurrentNestedIntervalStabber(): _snapshot(new Snapshot()), _epoch(0) {
+    _readers[0] = 0;
+    _readers[1] = 0;
+  }
+
+  // readers may hold pointers to the data-structure
+  ConcurrentNestedIntervalStabber(const ConcurrentNestedIntervalStabber&) = delete;
+  ConcurrentNestedIntervalStabber& operator=(const ConcurrentNestedIntervalStabber&) = delete;
+
+  ~ConcurrentNestedIntervalStabber() {
+    delete _snapshot.load();
+  }
+
+  //! Performs a stabbing query on the most recently published intervals. Can
+  //  be called by any number of threads concurrently with the writer.
+  const element_type* stab(const position_type& i) {
+    // register in the current epoch so the snapshot can't be freed
+    const uint64_t epoch = _epoch.load();
+    _readers[epoch & 1].fetch_add(1);
+    const Snapshot* snapshot = _snapshot.load();
+    const element_type* id = _stab(snapshot, i);
+    _run_searches.add(snapshot->runs.size());
+    _readers[epoch & 1].fetch_sub(1);
+    return id;
+  }
+
+  //! Performs all the stabbing queries on the same snapshot, registering in
+  //  an epoch only once.
+  void stabMany(
+    const std::vector<position_type>& positions,
+    std::vector<const element_type*>& out)
+  {
+    out.resize(positions.size());
+    const uint64_t epoch = _epoch.load();
+    _readers[epoch & 1].fetch_add(1);
+    const Snapshot* snapshot = _snapshot.load();
+    for (size_t k = 0; k < positions.size(); ++k) {
+      out[k] = _stab(snapshot, positions[k]);
+    }
+    _run_searches.add(positions.size() * snapshot->runs.size());
+    _readers[epoch & 1].fetch_sub(1);
+  }
+
+  //! Adds an interval assuming it's nested in an existing interval if there's
+  //  any overlap. The interval isn't visible to stabbing queries until the
+  //  next publish. Must only be called by the writer.
+  void update(const position_type& begin, const position_type& end, const element_type& id) {
+    // get the ID of the interval this interval will be nested in
+    const element_type* parent_id = _stab(begin);
+    // only add the end position if it isn't already set by another end or a
+    // begin
+    if (!_lookup.contains(end+1)) {
+      _set(end+1, parent_id);
+    }
+    // add the beginning of the interval
+    _ids.push_back(id);
+    _set(begin, &_ids.back());
+  }
+
+  //! Gets the boundaries of all the writer's updates, including those that
+  //  haven't been published. Must only be called by the writer.
+  void boundaries(
+    std::vector<position_type>& positions,
+    std::vector<const element_type*>& ids) const
+  {
+    positions.clear();
+    ids.clear();
+    for (const auto& [position, id]: _lookup) {
+      positions.push_back(position);
+      ids.push_back(id);
+    }
+  }
+
+  //! Makes all updates visible to stabbing queries. Blocks until the readers
+  //  of the previous snapshot have finished. Must only be called by the
+  //  writer.
+  //
+  //  O(d + log m) time, where d is the number of positions updated since the
+  //  last publish, plus O(log m) amortized time per position for merges.
+  void publish() {
+    if (_delta.empty()) {
+      return;
+    }
+    // turn the delta into the newest run
+    std::shared_ptr<Run> run(new Run());
+    run->positions.reserve(_delta.size());
+    run->ids.reserve(_delta.size());
+    for (const auto& [position, id]: _delta) {
+      run->positions.push_back(position);
+      run->ids.push_back(id);
+    }
+    _delta.clear();
+    // add it to a new snapshot, merging runs while the older of the newest
+    // two isn't more than twice as large
+    Snapshot* snapshot = new Snapshot(*_snapshot.load());
+    std::vector<std::shared_ptr<const Run>>& runs = snapshot->runs;
+    runs.push_back(std::move(run));
+    while (runs.size() > 1 &&
+           runs[runs.size()-2]->positions.size() <= 2 * runs.back()->positions.size())
+    {
+      std::shared_ptr<const Run> merged(
+        new Run(mergeRuns(*runs.back(), *runs[runs.size()-2])));
+      runs.pop_back();
+      runs.back() = std::move(merged);
+      _merges.add();
+    }
+    // swap the snapshot in; readers that register after this see it
+    const Snapshot* old_snapshot = _snapshot.exchange(snapshot);
+    // wait for the readers registered in both parities to finish, including
+    // readers that loaded a stale epoch
+    for (int k = 0; k < 2; ++k) {
+      const uint64_t epoch = _epoch.fetch_add(1);
+      while (_readers[epoch & 1].load() != 0) {
+        std::this_thread::yield();
+        _reader_waits.add();
+      }
+    }
+    delete old_snapshot;
+    _publishes.add();
+  }
+
+#ifdef MR_CFG_INSTRUMENT
+  void printCounters(std::ostream& out, const std::string& prefix) const {
+    out << "\t" << prefix << "runs searched: " << _run_searches.load()
+        << std::endl;
+    out << "\t" << prefix << "publishes: " << _publishes.load() << std::endl;
+    out << "\t" << prefix << "run merges: " << _merges.load() << std::endl;
+    out << "\t" << prefix << "publish waits for readers: "
+        << _reader_waits.load() << std::endl;
+  }
+#endif
+
 };
 
 
+//! A static interval stabbing data-structure built from the final state of
+//  another interval stabbing data-structure. Only the boundaries at which the
+//  results of stabbing queries change are kept: their positions are stored in
+//  an Elias-Fano encoded bit vector and their results in a bit-compressed array
+//  of indices into a dictionary of the distinct results. A stabbing query is a
+//  single rank query followed by two array accesses.
+template <typename element_type, typename position_type = uint64_t>
+class FrozenNestedIntervalStabber:
+  public NestedIntervalStabber<element_type, position_type>
+{
+
+private:
+
+  // the positions at which the results of stabbing queries change
+  sdsl::sd_vector<> _boundaries;
+  // supports rank queries on _boundaries
+  sdsl::sd_vector<>::rank_1_type _rank;
+  // the index in _elements of each boundary's result; _elements.size() means
+  // NULL
+  sdsl::int_vector<> _values;
+  // the distinct results of stabbing queries
+  std::vector<element_type> _elements;
+
+public:
+
+  //! Freezes the given data-structure; it's unaffected by later updates.
+  FrozenNestedIntervalStabber(
+    const NestedIntervalStabber<element_type, position_type>& intervals)
+  {
+    std::vector<position_type> positions;
+    std::vector<const element_type*> ids;
+    intervals.boundaries(positions, ids);
+
+    // index the results in a dictionary while dropping boundaries that don't
+    // change the result; boundaries before the first result are dropped too
+    // since stabbing a position without a boundary returns NULL
+    const size_t null_index = std::numeric_limits<size_t>::max();
+    std::unordered_map<element_type, size_t> indices;
+    std::vector<size_t> values;
+    size_t previous = null_index;
+    size_t num_boundaries = 0;
+    for (size_t k = 0; k < positions.size(); ++k) {
+      size_t value = null_index;
+      if (ids[k] != NULL) {
+        auto [iter, inserted] = indices.try_emplace(*ids[k], _elements.size());
+        if (inserted) {
+          _elements.push_back(*ids[k]);
+        }
+        value = iter->second;
+      }
+      if (value == previous) {
+        continue;
+      }
+      positions[num_boundaries] = positions[k];
+      values.push_back(value);
+      num_boundaries += 1;
+      previous = value;
+    }
+
+    // pack the boundaries and their results
+    _boundaries = sdsl::sd_vector<>(
+      positions.begin(), positions.begin() + num_boundaries);
+    _rank = sdsl::sd_vector<>::rank_1_type(&_boundaries);
+    const size_t null_value = _elements.size();
+    _values = sdsl::int_vector<>(
+      num_boundaries, null_value, sdsl::bits::hi(null_value) + 1);
+    for (size_t k = 0; k < num_boundaries; ++k) {
+      if (values[k] != null_index) {
+        _values[k] = values[k];
+      }
+    }
+  }
+
+  // the rank support points into the bit vector
+  FrozenNestedIntervalStabber(const FrozenNestedIntervalStabber&) = delete;
+  FrozenNestedIntervalStabber& operator=(const FrozenNestedIntervalStabber&) = delete;
+
+  const element_type* stab(const position_type& i) {
+    // get the number of boundaries up to i; the bit vector ends at the last
+    // boundary
+    const uint64_t rank =
+      _rank(std::min<uint64_t>(uint64_t(i) + 1, _boundaries.size()));
+    // return NULL if there's no boundary up to i
+    if (rank == 0) {
+      return NULL;
+    }
+    const uint64_t value = _values[rank-1];
+    if (value == _elements.size()) {
+      return NULL;
+    }
+    return &_elements[value];
+  }
+
+  //! Frozen data-structures can't be updated.
+  void update(const position_type&, const position_type&, const element_type&) {
+    throw std::logic_error(
+      "a frozen interval stabbing data-structure can't be updated");
+  }
+
+  void boundaries(
+    std::vector<position_type>& positions,
+    std::vector<const element_type*>& ids) const
+  {
+    positions.clear();
+    ids.clear();
+    sdsl::sd_vector<>::select_1_type select(&_boundaries);
+    for (size_t k = 0; k < _values.size(); ++k) {
+      positions.push_back(select(k+1));
+      const uint64_t value = _values[k];
+      ids.push_back(value == _elements.size() ? NULL : &_elements[value]);
+    }
+  }
+
+};
+
+
+//! Constructs the interval stabbing data-structure for the given algorithm.
+//  CONCURRENT data-structures only make updates visible to stabbing queries
+//  once they're published.
+/*!
+ *  \param algorithm The interval stabbing algorithm: OPTIMAL, ONLINE, LSM,
+ *    FAST, or CONCURRENT.
+ *  \param csa The compressed suffix array the intervals will be computed from.
+ *
+ *  \return The interval stabbing data-structure.
+ */
+template <typename element_type, typename position_type, class csa_wt>
+std::unique_ptr<NestedIntervalStabber<element_type, position_type>>
+makeNestedIntervalStabber(const std::string& algorithm, const csa_wt& csa)
+{
+  std::unique_ptr<NestedIntervalStabber<element_type, position_type>> intervals;
+  if (algorithm == "OPTIMAL") {
+    intervals.reset(
+      new OptimalNestedIntervalStabber<element_type, csa_wt, position_type>(csa));
+  } else if (algorithm == "ONLINE") {
+    intervals.reset(new OnlineNestedIntervalStabber<element_type, position_type>);
+  } else if (algorithm == "LSM") {
+    intervals.reset(new LsmNestedIntervalStabber<element_type, position_type>);
+  } else if (algorithm == "CONCURRENT") {
+    intervals.reset(new ConcurrentNestedIntervalStabber<element_type, position_type>);
+  } else {  // "FAST"
+    intervals.reset(new FastNestedIntervalStabber<element_type, position_type>);
+  }
+  return intervals;
+}
+
+
 }
 
 #endif
@@ -17,26 +17,785 @@
 #ifndef INCLUDED_MR_CFG_LCP
 #define INCLUDED_MR_CFG_LCP
 
-#include <queue>
-#include <unordered_set>
+#include <algorithm>  // fill, max, min
+#include <concepts>
+#include <limits>
+#include <memory>  // unique_ptr
+#include <span>
+#include <utility>  // as_const, swap
+#include <type_traits>  // invoke_result_t, is_same_v
 #include <vector>
 
 #include <sdsl/bit_vectors.hpp>
 
 #include "mr-cfg/generator.hpp"
+#include "mr-cfg/pool.hpp"
 
 
 namespace mr_cfg {
 
 
+//! An LCP-interval and the properties computed along with it.
+template <typename size_type>
+struct LcpInterval
+{
+  // the length of the prefix shared by the interval's suffixes
+  size_type lcp;
+  // the first and last CSA index of the interval
+  size_type begin;
+  size_type end;
+  // the number of distinct characters that precede the interval's suffixes
+  size_type left_extensions;
+  // whether the interval is a local maximum (for computing super maximal
+  // repeats)
+  bool loc_max;
+};
+
+
+//! Statistics about the memory used by an LCP-interval enumeration.
+struct LcpIntervalStatistics
+{
+  // the most intervals that were queued at once
+  uint64_t peak_queue_size = 0;
+  // the bytes used by the queued intervals at their peak
+  uint64_t peak_queue_bytes = 0;
+  // the bytes used by the bit vectors, or 0 if they were never used
+  uint64_t bit_vector_bytes = 0;
+  // the number of LCP values whose intervals were stored in bit vectors
+  uint64_t bit_vector_levels = 0;
+};
+
+
+//! A source of LCP-intervals in length-lexicographical order that outputs
+//  them one at a time or in batches, e.g. LcpIntervalEnumerator.
+template <class source_type>
+concept LcpIntervalSource = requires(
+  source_type& source,
+  typename source_type::interval_type& interval,
+  std::vector<typename source_type::interval_type>& batch)
+{
+  { source.next(interval) } -> std::convertible_to<bool>;
+  { source.nextBatch(batch) } -> std::convertible_to<std::size_t>;
+};
+
+
 //! An implementation of the algorithm from "Space-Efficient Computation of
 //  Maximal and Supermaximal Repeats in Genome Sequences" by Beller, et al.;
 //  computes all LCP-intervals of a string given using an FM-index.
 //
-//  LCP-intervals are computed in length-lexicographical order.
+//  LCP-intervals are computed in length-lexicographical order. The enumeration
+//  is driven one LCP-interval or one batch of LCP-intervals at a time so the
+//  generators below and other consumers can share it.
+//
+//  The left extensions of each LCP value's intervals can optionally be
+//  computed by multiple threads. Which intervals are extended and which
+//  LCP-intervals they delimit only depends on the finished bit vector, so it's
+//  determined sequentially first; the extensions are then computed in
+//  parallel for contiguous partitions of the intervals and merged in order, so
+//  the output is identical to the sequential enumeration's. The threads are
+//  created once, with the enumerator, and reused for every LCP value.
+//
+//  The intervals of an LCP value are disjoint and are processed in order of
+//  their left boundaries, so, as Beller, et al. describe, they can be stored
+//  as a pair of bit vectors that mark their left and right boundaries instead
+//  of in a queue. The sequential enumeration switches to the bit vectors
+//  whenever the next LCP value's queue grows larger than them and back to the
+//  queue for the LCP value after that, so the intervals use O(n) bits rather
+//  than O(n) words. The parallel enumeration always uses the queue since its
+//  partitions buffer their intervals anyway.
+//
+//  Every LCP-interval of an LCP value > 0 is a left extension of an
+//  LCP-interval of the previous LCP value, so the enumeration can optionally
+//  track, for each LCP-interval, the length of the longest proper suffix of
+//  its string that's a maximal repeat: a queued interval remembers the
+//  LCP-interval it was extended from, and that LCP-interval's suffix length is
+//  its own LCP value if it's maximal and its parent's otherwise. The bit
+//  vectors can't hold the parents, so tracking always uses the queue.
 //
 //  O(n\log\sigma), where n is the length of the string and \sigma is the size
 //  of the alphabet.
+template <class csa_wt,
+          typename value_type = typename csa_wt::wavelet_tree_type::value_type,
+          typename size_type = typename csa_wt::size_type>
+class LcpIntervalEnumerator
+{
+
+public:
+
+  typedef LcpInterval<size_type> interval_type;
+
+  // the minimum number of intervals each thread extends
+  static const size_type MIN_INTERVALS_PER_THREAD = 4096;
+
+  // the bytes a queued interval uses
+  static const size_type QUEUED_INTERVAL_BYTES =
+    2*sizeof(size_type) + sizeof(value_type);
+
+private:
+
+  //! The left extensions computed by one thread for a contiguous partition of
+  //  an LCP value's extended intervals.
+  struct Partition
+  {
+    // the number of left extensions of each interval
+    std::vector<size_type> num_symbols;
+    // the alphabet indices of the intervals' left extensions
+    std::vector<size_type> extensions;
+    // the next LCP value's intervals and their first symbols
+    std::vector<size_type> next;
+    std::vector<value_type> next_symbols;
+    std::vector<size_type> next_parents;
+    // the thread's variables for computing left extensions
+    std::vector<value_type> symbols;
+    std::vector<size_type> rank_c_lb;
+    std::vector<size_type> rank_c_rb;
+  };
+
+  const csa_wt& _csa;
+  size_type _sigma;  // text alphabet size
+
+  // the left extensions of the LCP-interval being computed are the symbols
+  // stamped with the current epoch, so they're cleared by advancing the epoch
+  std::vector<size_type> _extension_stamps;
+  size_type _extension_epoch;
+  size_type _num_extensions;
+
+  // the right boundaries of the LCP-intervals that have been computed
+  sdsl::bit_vector _finished;
+
+  // interval variables
+  size_type _lcp_value;  // LCP of interval being computed
+  size_type _last_idx;
+  size_type _last_lb;
+  bool _loc_max;  // is interval being computed a local maximum
+
+  // the intervals are double-buffered by LCP value: the left/right boundaries
+  // of the current LCP value's intervals in alphabetical order of their first
+  // symbol, and those of the next LCP value's intervals in the order they're
+  // computed along with their first symbols; the buffers are reused so no
+  // memory is allocated once they've grown to the largest LCP value's size
+  std::vector<size_type> _current;
+  std::vector<size_type> _next;
+  std::vector<value_type> _next_symbols;
+  std::vector<size_type> _symbol_offsets;
+  size_type _current_idx;  // the next interval of _current to process
+
+  // the left/right boundaries of the current and next LCP value's intervals
+  // when they're stored as bit vectors instead of queued; the current bits
+  // are cleared as they're read so the bit vectors are empty when swapped
+  size_type _max_queue_size;  // the most intervals queued before switching
+  bool _current_in_bits;
+  bool _next_in_bits;
+  sdsl::bit_vector _current_lbs;
+  sdsl::bit_vector _current_rbs;
+  sdsl::bit_vector _next_lbs;
+  sdsl::bit_vector _next_rbs;
+  size_type _lb_cursor;  // the next bit of _current_lbs to read
+  size_type _rb_cursor;  // the next bit of _current_rbs to read
+  LcpIntervalStatistics _statistics;
+
+  // the variables for computing left extensions
+  size_type _num_symbols;  // the number of unique characters in an extension
+  std::vector<value_type> _symbols;  // the unique characters in an extension
+  std::vector<size_type> _rank_c_rb;  // the left boundary rank for each character in symbols
+  std::vector<size_type> _rank_c_lb;  // the right boundary rank for each character in symbols
+
+  // the variables for computing an LCP value's LCP-intervals in parallel
+  unsigned _num_threads;
+  std::unique_ptr<ThreadPool> _pool;  // NULL if there's only one thread
+  std::vector<Partition> _partitions;
+  std::vector<size_type> _extended;  // the indices in _current of the intervals to extend
+  std::vector<size_type> _delimiters;  // the indices in _extended that end an LCP-interval
+  std::vector<interval_type> _level_intervals;  // the LCP value's LCP-intervals
+  size_type _level_idx;  // the next LCP-interval of _level_intervals to output
+  bool _level_computed;
+  std::vector<size_type> _owners;  // the index in _level_intervals each extended interval belongs to
+  std::vector<size_type> _level_suffixes;  // the proper maximal suffix length of each of _level_intervals
+
+  // the variables for tracking the longest proper suffix of each
+  // LCP-interval's string that's a maximal repeat: the index of the
+  // LCP-interval each queued interval was extended from among its LCP
+  // value's, and the longest suffix of each of the previous and current LCP
+  // value's LCP-intervals that's a maximal repeat, including the
+  // LCP-interval's string itself
+  bool _track_suffixes;
+  std::vector<size_type> _current_parents;
+  std::vector<size_type> _next_parents;
+  std::vector<size_type> _parent_suffixes;
+  std::vector<size_type> _suffixes;
+  size_type _maximal_suffix;  // the proper maximal suffix length of the last LCP-interval
+
+  //! Finds the first set bit at or after a position of a bit vector.
+  /*!
+   *  \param bits The bit vector.
+   *  \param i The position to search from.
+   *
+   *  \return The position of the set bit or the size of the bit vector if
+   *    there isn't one.
+   */
+  static size_type _nextSetBit(const sdsl::bit_vector& bits, size_type i) {
+    const uint64_t* words = bits.data();
+    const size_type num_words = (bits.size() + 63) / 64;
+    size_type w = i / 64;
+    if (w >= num_words) {
+      return bits.size();
+    }
+    uint64_t word = words[w] & (~0ULL << (i % 64));
+    while (word == 0) {
+      if (++w == num_words) {
+        return bits.size();
+      }
+      word = words[w];
+    }
+    return w*64 + __builtin_ctzll(word);
+  }
+
+  //! Gets the next of the current LCP value's intervals.
+  /*!
+   *  \param lb Where to output the interval's left boundary.
+   *  \param rb Where to output the interval's right boundary (exclusive).
+   *  \param parent Where to output the index of the LCP-interval the interval
+   *    was extended from, if suffixes are tracked.
+   *
+   *  \return Whether there was another interval.
+   */
+  bool _nextCurrent(size_type& lb, size_type& rb, size_type& parent) {
+    if (!_current_in_bits) {
+      if (_current_idx == _current.size()) {
+        return false;
+      }
+      lb = _current[_current_idx];
+      rb = _current[_current_idx+1];
+      if (_track_suffixes) {
+        parent = _current_parents[_current_idx/2];
+      }
+      _current_idx += 2;
+      return true;
+    }
+    // the intervals are disjoint so their boundaries are paired in order
+    _lb_cursor = _nextSetBit(_current_lbs, _lb_cursor);
+    if (_lb_cursor == _current_lbs.size()) {
+      return false;
+    }
+    _rb_cursor = _nextSetBit(_current_rbs, _rb_cursor);
+    lb = _lb_cursor;
+    rb = _rb_cursor;
+    _current_lbs[lb] = 0;
+    _current_rbs[rb] = 0;
+    return true;
+  }
+
+  //! Adds an interval to the next LCP value's intervals.
+  /*!
+   *  \param lb The interval's left boundary.
+   *  \param rb The interval's right boundary (exclusive).
+   *  \param k The alphabet index of the interval's first symbol.
+   */
+  void _pushNext(size_type lb, size_type rb, size_type k) {
+    if (_next_in_bits) {
+      _next_lbs[lb] = 1;
+      _next_rbs[rb] = 1;
+      return;
+    }
+    _next.push_back(lb);
+    _next.push_back(rb);
+    _next_symbols.push_back(k);
+    if (_track_suffixes) {
+      // the interval is extended from the LCP-interval being computed
+      _next_parents.push_back(_suffixes.size());
+    }
+    if (_next_symbols.size() > _max_queue_size) {
+      _switchNextToBits();
+    }
+  }
+
+  //! Moves the next LCP value's queued intervals into the bit vectors.
+  void _switchNextToBits() {
+    _updatePeakQueueSize();
+    if (_next_lbs.size() == 0) {
+      const size_type n = _csa.size();
+      _current_lbs = sdsl::bit_vector(n+1, 0);
+      _current_rbs = sdsl::bit_vector(n+1, 0);
+      _next_lbs = sdsl::bit_vector(n+1, 0);
+      _next_rbs = sdsl::bit_vector(n+1, 0);
+      _statistics.bit_vector_bytes = 4 * ((n+64) / 64) * sizeof(uint64_t);
+    }
+    for (size_type j = 0; j < _next.size(); j += 2) {
+      _next_lbs[_next[j]] = 1;
+      _next_rbs[_next[j+1]] = 1;
+    }
+    _next.clear();
+    _next_symbols.clear();
+    _next_in_bits = true;
+    _statistics.bit_vector_levels += 1;
+  }
+
+  //! Updates the peak queue size with the number of intervals queued now.
+  void _updatePeakQueueSize() {
+    const size_type queued =
+      (_current_in_bits ? 0 : _current.size() / 2) + _next_symbols.size();
+    if (queued > _statistics.peak_queue_size) {
+      _statistics.peak_queue_size = queued;
+      _statistics.peak_queue_bytes = queued *
+        (QUEUED_INTERVAL_BYTES + (_track_suffixes ? sizeof(size_type) : 0));
+    }
+  }
+
+  //! Processes the current LCP value's intervals until an LCP-interval is
+  //  found.
+  /*!
+   *  \param interval Where to output the LCP-interval.
+   *
+   *  \return Whether an LCP-interval was found before the current LCP value's
+   *    intervals were exhausted.
+   */
+  bool _nextInLevel(interval_type& interval) {
+    if (_num_threads > 1) {
+      if (!_level_computed) {
+        _computeLevel();
+      }
+      if (_level_idx == _level_intervals.size()) {
+        return false;
+      }
+      if (_track_suffixes) {
+        _maximal_suffix = _level_suffixes[_level_idx];
+      }
+      interval = _level_intervals[_level_idx++];
+      return true;
+    }
+    size_type lb, rb, parent = 0;
+    while (_nextCurrent(lb, rb, parent)) {
+      if (_finished[rb] && _last_idx != lb) {
+        continue;
+      }
+      // find all left extensions of the interval; unqualified so FM-indexes
+      // other than sdsl's can provide their own via argument-dependent lookup
+      interval_symbols(
+          _csa.wavelet_tree,
+          lb, rb,
+          _num_symbols, _symbols,
+          _rank_c_lb, _rank_c_rb
+        );
+      for (size_type j = 0; j < _num_symbols; ++j) {
+        // get the symbol and its alphabet index
+        value_type c = _symbols[j];
+        size_type k = _csa.char2comp[c];
+        // add to the current set of extensions
+        if (_extension_stamps[k] != _extension_epoch) {
+          _extension_stamps[k] = _extension_epoch;
+          _num_extensions += 1;
+        }
+        // skip if it's the delineator
+        if (c == 0) {
+          continue;
+        }
+        // compute the next interval from the symbol
+        _pushNext(_csa.C[k] + _rank_c_lb[j], _csa.C[k] + _rank_c_rb[j], k);
+      }
+      // add the current LCP-interval
+      if (!_finished[rb]) {
+        _finished[rb] = 1;
+        // check if lcp-interval wasn't seen before
+        if (_last_idx != lb) {
+          _last_lb = lb;
+        }
+        _last_idx = rb;
+      // found the last index of the current LCP-interval
+      } else {
+        if (lb != rb-1) {
+          _loc_max = false;
+        }
+        // output the interval for processing
+        interval.lcp = _lcp_value;
+        interval.begin = _last_lb;
+        interval.end = rb-1;
+        interval.left_extensions = _num_extensions;
+        interval.loc_max = _loc_max;
+        if (_track_suffixes) {
+          _maximal_suffix = _parent_suffixes[parent];
+          _suffixes.push_back(_num_extensions > 1 ? _lcp_value : _maximal_suffix);
+        }
+        // reset the interval variables
+        _extension_epoch += 1;
+        _num_extensions = 0;
+        _last_lb = 0;
+        _last_idx = 0;
+        _loc_max = true;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  //! Computes the left extensions of a contiguous range of the current LCP
+  //  value's extended intervals.
+  /*!
+   *  \param partition Where to output the left extensions.
+   *  \param begin The index in _extended of the first interval to extend.
+   *  \param end The index in _extended after the last interval to extend.
+   */
+  void _extend(Partition& partition, size_type begin, size_type end) const {
+    partition.num_symbols.clear();
+    partition.extensions.clear();
+    partition.next.clear();
+    partition.next_symbols.clear();
+    partition.next_parents.clear();
+    size_type num_symbols;
+    for (size_type p = begin; p < end; ++p) {
+      const size_type lb = _current[_extended[p]];
+      const size_type rb = _current[_extended[p]+1];
+      interval_symbols(
+          _csa.wavelet_tree,
+          lb, rb,
+          num_symbols, partition.symbols,
+          partition.rank_c_lb, partition.rank_c_rb
+        );
+      partition.num_symbols.push_back(num_symbols);
+      for (size_type j = 0; j < num_symbols; ++j) {
+        value_type c = partition.symbols[j];
+        size_type k = _csa.char2comp[c];
+        partition.extensions.push_back(k);
+        // skip if it's the delineator
+        if (c == 0) {
+          continue;
+        }
+        partition.next.push_back(_csa.C[k] + partition.rank_c_lb[j]);
+        partition.next.push_back(_csa.C[k] + partition.rank_c_rb[j]);
+        partition.next_symbols.push_back(k);
+        if (_track_suffixes) {
+          partition.next_parents.push_back(_owners[p]);
+        }
+      }
+    }
+  }
+
+  //! Computes all of the current LCP value's LCP-intervals and the next LCP
+  //  value's intervals, extending the intervals in parallel.
+  void _computeLevel() {
+    // determine which intervals are extended and which LCP-intervals they
+    // delimit; this only depends on the finished bit vector
+    _extended.clear();
+    _delimiters.clear();
+    _level_intervals.clear();
+    _owners.clear();
+    _level_suffixes.clear();
+    for (size_type i = 0; i < _current.size(); i += 2) {
+      size_type lb = _current[i];
+      size_type rb = _current[i+1];
+      if (_finished[rb] && _last_idx != lb) {
+        continue;
+      }
+      _extended.push_back(i);
+      if (_track_suffixes) {
+        _owners.push_back(_level_intervals.size());
+      }
+      if (!_finished[rb]) {
+        _finished[rb] = 1;
+        if (_last_idx != lb) {
+          _last_lb = lb;
+        }
+        _last_idx = rb;
+      } else {
+        _delimiters.push_back(_extended.size()-1);
+        _level_intervals.push_back({_lcp_value, _last_lb, rb-1, 0, lb == rb-1});
+        if (_track_suffixes) {
+          _level_suffixes.push_back(_parent_suffixes[_current_parents[i/2]]);
+        }
+        _last_lb = 0;
+        _last_idx = 0;
+      }
+    }
+
+    // extend contiguous partitions of the intervals in parallel
+    const size_type num_extended = _extended.size();
+    const size_type num_partitions = std::max<size_type>(1, std::min<size_type>(
+      _num_threads, num_extended / MIN_INTERVALS_PER_THREAD));
+    auto extend = [this, num_extended, num_partitions](unsigned t) {
+      if (t < num_partitions) {
+        _extend(
+          _partitions[t],
+          t * num_extended / num_partitions,
+          (t+1) * num_extended / num_partitions);
+      }
+    };
+    if (num_partitions == 1) {
+      extend(0);
+    } else {
+      _pool->run(extend);
+    }
+
+    // merge the partitions in order
+    size_type p = 0;  // the index in _extended of the interval being merged
+    size_type d = 0;  // the index of the next delimiter
+    for (size_type t = 0; t < num_partitions; ++t) {
+      const Partition& partition = _partitions[t];
+      size_type e = 0;
+      for (const size_type& num_symbols: partition.num_symbols) {
+        // add to the current set of extensions
+        for (size_type j = 0; j < num_symbols; ++j, ++e) {
+          const size_type k = partition.extensions[e];
+          if (_extension_stamps[k] != _extension_epoch) {
+            _extension_stamps[k] = _extension_epoch;
+            _num_extensions += 1;
+          }
+        }
+        // output the LCP-interval the interval delimits, if any
+        if (d < _delimiters.size() && _delimiters[d] == p) {
+          _level_intervals[d].left_extensions = _num_extensions;
+          if (_track_suffixes) {
+            _suffixes.push_back(
+              _num_extensions > 1 ? _lcp_value : _level_suffixes[d]);
+          }
+          _extension_epoch += 1;
+          _num_extensions = 0;
+          d += 1;
+        }
+        p += 1;
+      }
+      _next.insert(_next.end(), partition.next.begin(), partition.next.end());
+      _next_symbols.insert(
+        _next_symbols.end(),
+        partition.next_symbols.begin(), partition.next_symbols.end());
+      _next_parents.insert(
+        _next_parents.end(),
+        partition.next_parents.begin(), partition.next_parents.end());
+    }
+
+    _level_idx = 0;
+    _level_computed = true;
+  }
+
+  //! Makes the next LCP value's intervals the current intervals.
+  /*!
+   *  \return Whether there are any intervals for the next LCP value.
+   */
+  bool _nextLevel() {
+    _updatePeakQueueSize();
+    _current_idx = 0;
+    _level_computed = false;
+    _lcp_value += 1;
+    std::swap(_parent_suffixes, _suffixes);
+    _suffixes.clear();
+    // the intervals in the bit vectors are already in order
+    if (_next_in_bits) {
+      std::swap(_current_lbs, _next_lbs);
+      std::swap(_current_rbs, _next_rbs);
+      _current.clear();
+      _current_in_bits = true;
+      _next_in_bits = false;
+      _lb_cursor = 0;
+      _rb_cursor = 0;
+      return true;
+    }
+    _current_in_bits = false;
+    // stable counting sort the next LCP value's intervals by their first symbol
+    std::fill(_symbol_offsets.begin(), _symbol_offsets.end(), 0);
+    for (size_type j = 0; j < _next_symbols.size(); ++j) {
+      _symbol_offsets[_next_symbols[j]+1] += 1;
+    }
+    for (size_type k = 0; k < _sigma; ++k) {
+      _symbol_offsets[k+1] += _symbol_offsets[k];
+    }
+    _current.resize(_next.size());
+    _current_parents.resize(_next_parents.size());
+    for (size_type j = 0; j < _next_symbols.size(); ++j) {
+      const size_type q = _symbol_offsets[_next_symbols[j]]++;
+      _current[2*q] = _next[2*j];
+      _current[2*q+1] = _next[2*j+1];
+      if (_track_suffixes) {
+        _current_parents[q] = _next_parents[j];
+      }
+    }
+    _next.clear();
+    _next_symbols.clear();
+    _next_parents.clear();
+    return !_current.empty();
+  }
+
+public:
+
+  //! Constructs an enumerator.
+  /*!
+   *  \param csa The FM-index (here a compressed suffix array).
+   *  \param num_threads The number of threads to compute left extensions with.
+   *  \param max_queue_size The most intervals the sequential enumeration
+   *    queues before switching to bit vectors; 0 means as many as fit in the
+   *    bit vectors' memory.
+   *  \param track_suffixes Whether to track the longest proper suffix of each
+   *    LCP-interval's string that's a maximal repeat.
+   */
+  LcpIntervalEnumerator(
+    const csa_wt& csa,
+    unsigned num_threads = 1,
+    size_type max_queue_size = 0,
+    bool track_suffixes = false):
+    _csa(csa),
+    _sigma(csa.wavelet_tree.sigma),
+    _extension_stamps(_sigma, 0),
+    _extension_epoch(1),
+    _num_extensions(0),
+    _finished(csa.size()+1, 0),
+    _lcp_value(0),
+    _last_idx(0),
+    _last_lb(0),
+    _loc_max(true),
+    _symbol_offsets(_sigma+1),
+    _current_idx(0),
+    _max_queue_size(max_queue_size),
+    _current_in_bits(false),
+    _next_in_bits(false),
+    _lb_cursor(0),
+    _rb_cursor(0),
+    _symbols(_sigma),
+    _rank_c_rb(_sigma),
+    _rank_c_lb(_sigma),
+    _num_threads(std::max(1u, num_threads)),
+    _partitions(_num_threads),
+    _level_idx(0),
+    _level_computed(false),
+    _track_suffixes(track_suffixes),
+    _maximal_suffix(0)
+  {
+    _finished[0] = _finished[csa.size()] = 1;
+    if (_num_threads > 1) {
+      _pool.reset(new ThreadPool(_num_threads));
+    }
+    // two pairs of (n+1)-bit vectors
+    if (_max_queue_size == 0) {
+      _max_queue_size =
+        std::max<size_type>(1, (4 * ((csa.size()+64) / 64) * sizeof(uint64_t)) /
+          QUEUED_INTERVAL_BYTES);
+    }
+    if (_num_threads > 1 || _track_suffixes) {
+      _max_queue_size = std::numeric_limits<size_type>::max();
+    }
+    for (Partition& partition: _partitions) {
+      partition.symbols.resize(_sigma);
+      partition.rank_c_lb.resize(_sigma);
+      partition.rank_c_rb.resize(_sigma);
+    }
+    // store first interval
+    for (size_type i = 0; i < _sigma; ++i) {
+      _current.push_back(csa.C[i]);
+      _current.push_back(csa.C[i+1]);
+    }
+    // the first interval's parent is the empty string, which has no suffixes
+    if (_track_suffixes) {
+      _current_parents.assign(_sigma, 0);
+      _parent_suffixes.push_back(0);
+    }
+  }
+
+  //! Computes the next LCP-interval.
+  /*!
+   *  \param interval Where to output the LCP-interval.
+   *
+   *  \return Whether there was another LCP-interval.
+   */
+  bool next(interval_type& interval) {
+    while (!_nextInLevel(interval)) {
+      if (!_nextLevel()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  //! Gets statistics about the memory used by the enumeration so far.
+  const LcpIntervalStatistics& statistics() const {
+    return _statistics;
+  }
+
+  //! Gets the length of the longest proper suffix of the last LCP-interval's
+  //  string that's a maximal repeat, or 0 if there isn't one. Only computed if
+  //  the enumerator tracks suffixes.
+  size_type maximalSuffixLength() const {
+    return _maximal_suffix;
+  }
+
+  //! Computes the next batch of LCP-intervals.
+  /*!
+   *  \param batch Where to output the LCP-intervals; its previous contents are
+   *    cleared.
+   *  \param block_size The number of LCP-intervals in a batch, or 0 to compute
+   *    all the LCP-intervals with the next LCP value as one batch. The last
+   *    batch may be smaller than the block size.
+   *
+   *  \return The number of LCP-intervals in the batch; 0 once all have been
+   *    computed.
+   */
+  size_type nextBatch(std::vector<interval_type>& batch, size_type block_size = 0) {
+    batch.clear();
+    interval_type interval;
+    while (true) {
+      while ((block_size == 0 || batch.size() < block_size) &&
+             _nextInLevel(interval))
+      {
+        batch.push_back(interval);
+      }
+      if (block_size == 0 ? !batch.empty() : batch.size() == block_size) {
+        return batch.size();
+      }
+      if (!_nextLevel()) {
+        return batch.size();
+      }
+    }
+  }
+
+};
+
+
+//! Calls a visitor with each LCP-interval of a source in order. Unlike the
+//  generators below, there's no coroutine frame to allocate or resume, so the
+//  visitor can be inlined into the enumeration loop. If the visitor returns a
+//  bool, the enumeration stops when it returns false.
+/*!
+ *  \param lcp_intervals The source of the LCP-intervals.
+ *  \param visitor A callable that takes a const reference to an LCP-interval.
+ */
+template <LcpIntervalSource source_type, class visitor_type>
+void for_each_lcp_interval(source_type& lcp_intervals, visitor_type&& visitor) {
+  typedef typename source_type::interval_type interval_type;
+  interval_type interval;
+  while (lcp_intervals.next(interval)) {
+    if constexpr (std::is_same_v<std::invoke_result_t<visitor_type&, const interval_type&>, bool>) {
+      if (!visitor(std::as_const(interval))) {
+        return;
+      }
+    } else {
+      visitor(std::as_const(interval));
+    }
+  }
+}
+
+
+//! Calls a visitor with each LCP-interval of a string given using an FM-index
+//  in order; see LcpIntervalEnumerator.
+/*!
+ *  \param csa The FM-index (here a compressed suffix array).
+ *  \param visitor A callable that takes a const reference to an LCP-interval.
+ *    If it returns a bool, the enumeration stops when it returns false.
+ *  \param num_threads The number of threads to compute left extensions with.
+ *  \param statistics Where to output statistics about the enumeration's
+ *    memory once it finishes, if not NULL.
+ */
+template <class csa_wt, class visitor_type>
+void for_each_lcp_interval(
+  const csa_wt& csa,
+  visitor_type&& visitor,
+  unsigned num_threads = 1,
+  LcpIntervalStatistics* statistics = NULL)
+{
+  LcpIntervalEnumerator<csa_wt> lcp_intervals(csa, num_threads);
+  for_each_lcp_interval(lcp_intervals, visitor);
+  if (statistics != NULL) {
+    *statistics = lcp_intervals.statistics();
+  }
+}
+
+
+//! Computes all LCP-intervals of a string given using an FM-index, one at a
+//  time; see LcpIntervalEnumerator.
 /*!
  *  \param csa The FM-index (here a compressed suffix array).
  *  \param interval A vector used to output LCP-intervals: {LCP-value, begin, end}.
@@ -53,126 +812,55 @@ lcp_interval_generator(
   const csa_wt& csa, std::vector<size_type>& interval, bool& loc_max)
 {
 
-  // initialize text variables
-  const size_type n = csa.size();  // text size
-  const size_type sigma = csa.wavelet_tree.sigma;  // text alphabet size
-
   // initialize the outputs
-  //bit_vector extensions(sigma, 0);
-  std::unordered_set<value_type> extensions;
   interval.resize(3);
+  loc_max = true;
 
-  // initialize the finished bit vector
-  sdsl::bit_vector finished(n+1, 0);
-  finished[0] = finished[n] = 1;
-
-  // initialize interval variables
-  size_type l, r;  // left/right boundary of intervals being computed
-  size_type lcp_value = 0;  // LCP of interval being computed
-  size_type last_idx = 0; // ...
-  size_type last_lb = 0;  // ...
-  loc_max = true;  // is interval being computed a local maximum
-
-  // initialize a left/right boundary queue for each alphabet letter
-  // NOTE: the arrays should be used instead of the vectors when GCC adds
-  // support for variable length arrays in coroutines
-  //queue<size_type> queues[sigma];
-  std::vector<std::queue<size_type>> queues(sigma);
-  //size_type queue_sizes[sigma];
-  std::vector<size_type> queue_sizes(sigma);
-  size_type intervals = 0;
-  // store first interval
-  for (size_type i = 0; i < sigma; ++i) {
-    l = csa.C[i];
-    r = csa.C[i+1];
-    queues[i].push(l);
-    queues[i].push(r);
-    intervals += 1;
-  }
-
-  // initialize the variables for computing left extensions
-  size_type num_symbols;  // the number of unique characters in an extension
-  std::vector<value_type> symbols(sigma);  // the unique characters in an extension
-  std::vector<size_type> rank_c_rb(sigma);  // the left boundary rank for each character in symbols
-  std::vector<size_type> rank_c_lb(sigma);  // the right boundary rank for each character in symbols
-  value_type c = 0;
-
-  // initialize loop variables
-  size_type i, j, k;
-
-  // loop until all LCP-intervals have been computed
-  while (intervals) {
-    // set the interval size
-    interval[0] = lcp_value;
-    // get the queue sizes for the LCP value before adding more intervals
-    for (i = 0; i < sigma; ++i) {
-      queue_sizes[i] = queues[i].size()/2;
-    }
-    // iterate the queues in alphabetical order
-    for (i = 0; i < sigma; ++i) {
-      // iterate all intervals in the queue for the current LCP value
-      while (queue_sizes[i]) {
-        queue_sizes[i] -= 1;
-        // get the interval for this iteration
-        size_type lb = queues[i].front();
-        queues[i].pop();
-        size_type rb = queues[i].front();
-        queues[i].pop();
-        intervals -= 1;
-        if (!finished[rb] || last_idx == lb) {
-          // find all left extensions of the interval
-          sdsl::interval_symbols(
-              csa.wavelet_tree,
-              lb, rb,
-              num_symbols, symbols,
-              rank_c_lb, rank_c_rb
-            );
-          for (j = 0; j < num_symbols; ++j) {
-            // get the symbol
-            c = symbols[j];
-            // add to the current set of extensions
-            extensions.insert(c);
-            // skip if it's the delineator
-            if (c == 0) {
-              continue;
-            }
-            // get the symbol's alphabet index
-            k = csa.char2comp[c];
-            // compute the next interval from the symbol
-            l = csa.C[k] + rank_c_lb[j];
-            r = csa.C[k] + rank_c_rb[j];
-            // add the interval to the symbol's queue
-            queues[k].push(l);
-            queues[k].push(r);
-            intervals += 1;
-          }
-          // add the current LCP-interval
-          if (!finished[rb]) {
-            finished[rb] = 1;
-            // check if lcp-interval wasn't seen before
-            if (last_idx != lb) {
-              last_lb = lb;
-            }
-            last_idx = rb;
-          // found the last index of the current LCP-interval
-          } else if (last_idx == lb) {
-            if (lb != rb-1) {
-              loc_max = false;
-            }
-            // output the interval for processing
-            interval[1] = last_lb;
-            interval[2] = rb-1;
-            co_yield extensions.size();
-            // reset the interval variables
-            extensions.clear();
-            last_lb = 0;
-            last_idx = 0;
-            loc_max = true;
-          }
-        }
-      }
-    }
-    lcp_value += 1;
+  LcpIntervalEnumerator<csa_wt, value_type, size_type> enumerator(csa);
+  LcpInterval<size_type> lcp_interval;
+  while (enumerator.next(lcp_interval)) {
+    interval[0] = lcp_interval.lcp;
+    interval[1] = lcp_interval.begin;
+    interval[2] = lcp_interval.end;
+    loc_max = lcp_interval.loc_max;
+    co_yield lcp_interval.left_extensions;
+  }
+
+}
+
+
+//! Computes all LCP-intervals of a string given using an FM-index in batches,
+//  so consumers pay the cost of resuming the generator once per batch rather
+//  than once per LCP-interval; see LcpIntervalEnumerator.
+/*!
+ *  \param csa The FM-index (here a compressed suffix array).
+ *  \param block_size The number of LCP-intervals in a batch, or 0 to output
+ *    all the LCP-intervals with the same LCP value as one batch.
+ *  \param num_threads The number of threads to compute left extensions with.
+ *  \param statistics Where to output statistics about the enumeration's
+ *    memory once it finishes, if not NULL.
+ *
+ *  \return A batch of LCP-intervals, which is valid until the generator is
+ *    resumed.
+ */
+template <class csa_wt,
+          typename value_type = typename csa_wt::wavelet_tree_type::value_type,
+          typename size_type = typename csa_wt::size_type>
+Generator<std::span<const LcpInterval<size_type>>>
+lcp_interval_batch_generator(
+  const csa_wt& csa,
+  typename csa_wt::size_type block_size = 0,
+  unsigned num_threads = 1,
+  LcpIntervalStatistics* statistics = NULL)
+{
+
+  LcpIntervalEnumerator<csa_wt, value_type, size_type> enumerator(csa, num_threads);
+  std::vector<LcpInterval<size_type>> batch;
+  while (enumerator.nextBatch(batch, block_size) > 0) {
+    co_yield std::span<const LcpInterval<size_type>>(batch);
+  }
+  if (statistics != NULL) {
+    *statistics = enumerator.statistics();
   }
 
 }
@@ -0,0 +1,294 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDED_MR_CFG_LCP_ARRAY
+#define INCLUDED_MR_CFG_LCP_ARRAY
+
+#include <algorithm>  // min
+#include <vector>
+
+#include <sdsl/int_vector.hpp>
+
+#include "mr-cfg/lcp.hpp"
+
+
+namespace mr_cfg {
+
+
+//! Computes the LCP array of the string a compressed suffix array (CSA) was
+//  built from, where the kth value is the length of the longest common prefix
+//  of the (k-1)th and kth suffixes. The suffix array and the string are
+//  recovered by walking the LF mapping from the last suffix to the first and
+//  the LCP array is then computed with the \Phi array algorithm of Karkkainen,
+//  et al.
+//
+//  O(n) time, excluding CSA-specific operations, and O(n\log{n}) bits of
+//  working space, where n is the size of the CSA.
+/*!
+ *  \param csa The CSA.
+ *
+ *  \return The bit-compressed LCP array.
+ */
+template <class csa_wt, typename size_type = typename csa_wt::size_type>
+sdsl::int_vector<> computeLcpArray(const csa_wt& csa) {
+  const size_type n = csa.size();
+  const uint8_t width = sdsl::bits::hi(n) + 1;
+
+  // recover the suffix array and the string; the first suffix is the last
+  // character, i.e. the terminating character
+  sdsl::int_vector<> sa(n, 0, width);
+  sdsl::int_vector<8> text(n, 0);
+  size_type r = 0;
+  for (size_type p = n; p-- > 0;) {
+    sa[r] = p;
+    if (p > 0) {
+      text[p-1] = csa.bwt[r];
+    }
+    r = csa.lf[r];
+  }
+
+  // compute the permuted LCP array in text order, overwriting \Phi as it's
+  // read
+  sdsl::int_vector<> plcp(n, 0, width);
+  for (size_type i = 1; i < n; ++i) {
+    plcp[sa[i]] = sa[i-1];
+  }
+  size_type l = 0;
+  for (size_type p = 0; p < n; ++p) {
+    if (p == sa[0]) {
+      plcp[p] = 0;
+      l = 0;
+      continue;
+    }
+    // the terminating character is unique so the comparison stops before the
+    // end of the string
+    const size_type q = plcp[p];
+    while (text[p+l] == text[q+l]) {
+      l += 1;
+    }
+    plcp[p] = l;
+    if (l > 0) {
+      l -= 1;
+    }
+  }
+
+  // permute the LCP values into suffix array order, overwriting the suffix
+  // array
+  for (size_type i = 0; i < n; ++i) {
+    sa[i] = plcp[sa[i]];
+  }
+  sdsl::util::bit_compress(sa);
+  return sa;
+}
+
+
+//! Computes all LCP-intervals of a string from its LCP array, e.g. one built
+//  with sdsl::construct_lcp or stored in a DAC-compressed sdsl::lcp_dac, as an
+//  alternative to LcpIntervalEnumerator that trades memory for speed.
+//
+//  The LCP-intervals are computed bottom-up with a stack, as described by
+//  Abouelhoda, et al., and are bucketed by LCP value so they're output in the
+//  same length-lexicographical order as LcpIntervalEnumerator. The left
+//  extensions of each interval are the union of its children's, which are kept
+//  as a bit set over the alphabet on the stack.
+//
+//  O(n\sigma/w) time, excluding CSA-specific operations, and O(n) words of
+//  space for the buffered LCP-intervals, where n is the size of the CSA and w
+//  is the size of a machine word.
+template <class csa_wt,
+          typename value_type = typename csa_wt::wavelet_tree_type::value_type,
+          typename size_type = typename csa_wt::size_type>
+class LcpArrayIntervalSource
+{
+
+public:
+
+  typedef LcpInterval<size_type> interval_type;
+
+private:
+
+  //! An LCP-interval on the stack whose right boundary hasn't been found.
+  struct OpenInterval
+  {
+    size_type lcp;
+    size_type begin;
+    // the end of the interval's last child interval, if it has one; otherwise
+    // the size of the CSA
+    size_type last_child_end;
+  };
+
+  // the LCP-intervals in length-lexicographical order
+  std::vector<interval_type> _intervals;
+  size_type _next_idx;  // the next LCP-interval of _intervals to output
+
+  //! Computes the LCP-intervals.
+  /*!
+   *  \param csa The CSA.
+   *  \param lcp The LCP array of the string the CSA was built from.
+   */
+  template <class lcp_type>
+  void initialize(const csa_wt& csa, const lcp_type& lcp) {
+    const size_type n = csa.size();
+
+    // count the LCP-intervals with each LCP value
+    std::vector<size_type> offsets(1, 1);  // the root interval
+    std::vector<size_type> lcps(1, 0);
+    for (size_type i = 1; i <= n; ++i) {
+      const size_type value = i < n ? size_type(lcp[i]) : 0;
+      while (value < lcps.back()) {
+        offsets[lcps.back()] += 1;
+        lcps.pop_back();
+      }
+      if (value > lcps.back()) {
+        lcps.push_back(value);
+        if (value >= offsets.size()) {
+          offsets.resize(value+1, 0);
+        }
+      }
+    }
+    size_type total = 0;
+    for (size_type& offset: offsets) {
+      const size_type count = offset;
+      offset = total;
+      total += count;
+    }
+    _intervals.resize(total);
+
+    // compute the LCP-intervals, placing them in their LCP value's bucket;
+    // LCP-intervals with the same LCP value are disjoint so they're computed
+    // in order of their begin positions
+    const size_type words = (csa.sigma + 63) / 64;
+    std::vector<OpenInterval> stack(1, {0, 0, n});
+    std::vector<uint64_t> extensions(words, 0);  // a bit set for each interval on the stack
+    auto addLeaf = [&](size_type i) {
+      const size_type k = csa.char2comp[csa.bwt[i]];
+      extensions[(stack.size()-1)*words + k/64] |= 1ULL << (k % 64);
+    };
+    auto output = [&](const OpenInterval& interval, size_type end) {
+      size_type left_extensions = 0;
+      for (size_type w = (stack.size()-1)*words; w < stack.size()*words; ++w) {
+        left_extensions += __builtin_popcountll(extensions[w]);
+      }
+      _intervals[offsets[interval.lcp]++] = {
+        interval.lcp, interval.begin, end, left_extensions,
+        interval.last_child_end != end};
+    };
+    for (size_type i = 1; i <= n; ++i) {
+      const size_type value = i < n ? size_type(lcp[i]) : 0;
+      // the (i-1)th suffix is in the deepest interval that contains it
+      if (value > stack.back().lcp) {
+        stack.push_back({value, i-1, n});
+        extensions.resize(stack.size()*words, 0);
+        addLeaf(i-1);
+        continue;
+      }
+      addLeaf(i-1);
+      // close the intervals that end at the (i-1)th suffix
+      while (value < stack.back().lcp) {
+        const OpenInterval interval = stack.back();
+        output(interval, i-1);
+        stack.pop_back();
+        if (value <= stack.back().lcp) {
+          // the interval is a child of the interval below it
+          const size_type child = stack.size()*words;
+          for (size_type w = 0; w < words; ++w) {
+            extensions[child-words+w] |= extensions[child+w];
+          }
+          extensions.resize(child);
+          stack.back().last_child_end = i-1;
+        } else {
+          // the interval is the first child of a new interval, which inherits
+          // its left extensions
+          stack.push_back({value, interval.begin, i-1});
+        }
+      }
+    }
+    output(stack.back(), n-1);
+
+    _next_idx = 0;
+  }
+
+public:
+
+  //! Computes the LCP-intervals of a compressed suffix array (CSA) using an LCP
+  //  array computed in memory.
+  /*!
+   *  \param csa The CSA.
+   */
+  LcpArrayIntervalSource(const csa_wt& csa) {
+    initialize(csa, computeLcpArray(csa));
+  }
+
+  //! Computes the LCP-intervals of a compressed suffix array (CSA) using the
+  //  given LCP array.
+  /*!
+   *  \param csa The CSA.
+   *  \param lcp The LCP array of the string the CSA was built from; any
+   *    random access container of LCP values, e.g. an sdsl::int_vector or an
+   *    sdsl::lcp_dac.
+   */
+  template <class lcp_type>
+  LcpArrayIntervalSource(const csa_wt& csa, const lcp_type& lcp) {
+    initialize(csa, lcp);
+  }
+
+  //! Gets the next LCP-interval.
+  /*!
+   *  \param interval Where to output the LCP-interval.
+   *
+   *  \return Whether there was another LCP-interval.
+   */
+  bool next(interval_type& interval) {
+    if (_next_idx == _intervals.size()) {
+      return false;
+    }
+    interval = _intervals[_next_idx++];
+    return true;
+  }
+
+  //! Gets the next batch of LCP-intervals.
+  /*!
+   *  \param batch Where to output the LCP-intervals; its previous contents are
+   *    cleared.
+   *  \param block_size The number of LCP-intervals in a batch, or 0 to get
+   *    all the LCP-intervals with the next LCP value as one batch. The last
+   *    batch may be smaller than the block size.
+   *
+   *  \return The number of LCP-intervals in the batch; 0 once all have been
+   *    output.
+   */
+  size_type nextBatch(std::vector<interval_type>& batch, size_type block_size = 0) {
+    size_type end = _next_idx;
+    if (block_size == 0) {
+      while (end < _intervals.size() &&
+             _intervals[end].lcp == _intervals[_next_idx].lcp)
+      {
+        end += 1;
+      }
+    } else {
+      end = std::min<size_type>(_intervals.size(), _next_idx + block_size);
+    }
+    batch.assign(_intervals.begin() + _next_idx, _intervals.begin() + end);
+    _next_idx = end;
+    return batch.size();
+  }
+
+};
+
+
+}
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDED_MR_CFG_MAXIMAL
+#define INCLUDED_MR_CFG_MAXIMAL
+
+#include <vector>
+
+#include "mr-cfg/identifier.hpp"
+#include "mr-cfg/lcp.hpp"
+
+
+namespace mr_cfg {
+
+
+//! A maximal repeat LCP-interval along with what's needed to build its rule.
+template <typename size_type>
+struct MaximalRepeatInterval
+{
+  size_type lcp;  // the repeat's length
+  size_type begin;
+  size_type end;
+  id_type id;
+  // the length of the repeat's rule, i.e. the repeat's length minus that of
+  // its longest proper suffix that's a maximal repeat
+  size_type length;
+  // the text position of the first suffix in the interval
+  size_type position;
+};
+
+
+//! Computes the maximal repeat LCP-intervals of a compressed suffix array
+//  (CSA) in length-lexicographical order, i.e. the LCP-intervals grammar
+//  construction adds rules for, using an LcpIntervalEnumerator.
+//
+//  Each repeat's ID and length are computed the same way as if every
+//  LCP-interval were consumed and given an ID based on its end position (see
+//  OnlineLcpIdentifiers), but without doing any work for the intervals that
+//  aren't maximal: the enumerator tracks the longest proper suffix of each
+//  LCP-interval's string that's a maximal repeat, so a repeat's length is the
+//  difference of their lengths and IDs are assigned as repeats are output.
+//  Only the maximal intervals' text positions are looked up in the CSA.
+//
+//  Suffix tracking keeps the intervals in the enumerator's queue, so unlike
+//  the LcpIntervalEnumerator default, the enumeration uses O(n) words in the
+//  worst case. Grammar construction therefore only uses this enumerator when
+//  it's asked for; by default it consumes every LCP-interval so the queue can
+//  fall back to bit vectors.
+template <class csa_wt, typename size_type = typename csa_wt::size_type>
+class MaximalRepeatEnumerator
+{
+
+public:
+
+  typedef MaximalRepeatInterval<size_type> interval_type;
+
+private:
+
+  const csa_wt& _csa;
+  LcpIntervalEnumerator<csa_wt> _lcp_intervals;
+  id_type _next_id;
+
+  // an interval computed by nextBatch that belongs to the next batch
+  interval_type _pending;
+  bool _has_pending;
+
+  //! Computes the next maximal repeat LCP-interval.
+  bool _nextMaximal(interval_type& interval) {
+    typename LcpIntervalEnumerator<csa_wt>::interval_type lcp_interval;
+    while (_lcp_intervals.next(lcp_interval)) {
+      // skip the length 0 LCP-interval and non-maximal repeats
+      if (lcp_interval.lcp == 0 || lcp_interval.left_extensions <= 1) {
+        continue;
+      }
+      interval.lcp = lcp_interval.lcp;
+      interval.begin = lcp_interval.begin;
+      interval.end = lcp_interval.end;
+      interval.id = _next_id++;
+      interval.length =
+        lcp_interval.lcp - _lcp_intervals.maximalSuffixLength();
+      interval.position = _csa[lcp_interval.begin];
+      return true;
+    }
+    return false;
+  }
+
+public:
+
+  //! Constructs an enumerator.
+  /*!
+   *  \param csa The CSA.
+   *  \param num_threads The number of threads to compute LCP-intervals with.
+   */
+  MaximalRepeatEnumerator(const csa_wt& csa, unsigned num_threads = 1):
+    _csa(csa),
+    _lcp_intervals(csa, num_threads, 0, true),
+    // the first \sigma IDs are reserved for the alphabet characters
+    _next_id(csa.sigma),
+    _has_pending(false)
+  { }
+
+  //! Computes the next maximal repeat LCP-interval.
+  /*!
+   *  \param interval Where to output the LCP-interval.
+   *
+   *  \return Whether there was another maximal repeat LCP-interval.
+   */
+  bool next(interval_type& interval) {
+    if (_has_pending) {
+      interval = _pending;
+      _has_pending = false;
+      return true;
+    }
+    return _nextMaximal(interval);
+  }
+
+  //! Computes the next batch of maximal repeat LCP-intervals.
+  /*!
+   *  \param batch Where to output the LCP-intervals; its previous contents are
+   *    cleared.
+   *  \param block_size The number of LCP-intervals in a batch, or 0 to output
+   *    all the maximal repeats with the next LCP value that has any as one
+   *    batch. The last batch may be smaller than the block size.
+   *
+   *  \return The number of LCP-intervals in the batch; 0 once all have been
+   *    computed.
+   */
+  size_type nextBatch(std::vector<interval_type>& batch, size_type block_size = 0) {
+    batch.clear();
+    interval_type interval;
+    while ((block_size == 0 || batch.size() < block_size) && next(interval)) {
+      if (block_size == 0 && !batch.empty() && interval.lcp != batch.back().lcp) {
+        _pending = interval;
+        _has_pending = true;
+        break;
+      }
+      batch.push_back(interval);
+    }
+    return batch.size();
+  }
+
+  //! Gets the ID that wasn't assigned to any repeat, i.e. the next ID.
+  id_type getNextId() const {
+    return _next_id;
+  }
+
+  //! Gets statistics about the memory used by the enumeration so far.
+  const LcpIntervalStatistics& statistics() const {
+    return _lcp_intervals.statistics();
+  }
+
+};
+
+
+}
+
+#endif
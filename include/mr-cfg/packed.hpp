@@ -0,0 +1,399 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDED_MR_CFG_PACKED
+#define INCLUDED_MR_CFG_PACKED
+
+#include <algorithm>  // min
+#include <bit>  // countr_zero, popcount
+#include <cstdint>
+#include <cstring>  // memcpy
+#include <stdexcept>  // invalid_argument
+#include <utility>  // pair
+#include <vector>
+
+#include "mr-cfg/sampled.hpp"
+
+
+namespace mr_cfg {
+
+
+//! A Burrows-Wheeler Transform (BWT) of a text with a small alphabet, e.g.
+//  DNA, that supports the wavelet tree operations LCP-interval enumeration
+//  uses, i.e. access, rank, select, and interval_symbols.
+//
+//  The BWT's characters, other than the terminal character, are packed into 2
+//  bits each if the text has at most 4 distinct characters and 3 bits each if
+//  it has at most 8. The terminal character occurs once, so its position is
+//  stored separately. The BWT is divided into blocks of one 64-byte cache
+//  line each: the first words of a block hold how many times each character
+//  occurs before the block, relative to the superblock the block is in, and
+//  the remaining words hold the block's characters. A rank is thus a couple
+//  of counts plus the popcounts of at most a few words of a single block.
+class PackedBwt
+{
+
+public:
+
+  typedef uint64_t size_type;
+  typedef uint8_t value_type;
+
+private:
+
+  static constexpr size_type BLOCK_WORDS = 8;
+  static constexpr size_type SUPERBLOCK_BLOCKS = 1 << 16;
+  static constexpr uint8_t NO_CODE = 0xFF;
+
+  size_type _size;
+  size_type _bits;
+  size_type _codes;  // the number of codes a width of _bits has
+  size_type _count_words;
+  size_type _word_chars;
+  size_type _block_chars;
+  size_type _num_blocks;
+  // the position of the terminal character and the number of times the
+  // character packed in its place occurs before it
+  size_type _terminator;
+  size_type _terminator_rank;
+  std::vector<uint8_t> _char_codes;
+  std::vector<value_type> _code_chars;
+  // a code in every field of a word and the low bit of every field
+  std::vector<uint64_t> _code_patterns;
+  uint64_t _low_bits;
+  // the blocks, over-allocated so they can be aligned to cache lines
+  std::vector<uint64_t> _words;
+  size_type _first_word;
+  // for each superblock, the number of times each code occurs before it
+  std::vector<size_type> _superblock_counts;
+
+  //! Gets a pointer to the bth block.
+  const uint64_t* _block(const size_type& b) const {
+    return _words.data() + _first_word + b * BLOCK_WORDS;
+  }
+
+  //! Sets the low bit of each field of a word that holds a code.
+  uint64_t _matches(const uint64_t& word, const uint8_t& code) const {
+    uint64_t x = word ^ _code_patterns[code];
+    if (_bits == 2) {
+      x |= x >> 1;
+    } else {
+      x |= (x >> 1) | (x >> 2);
+    }
+    return ~x & _low_bits;
+  }
+
+  //! Gets the number of times a code occurs before a block.
+  size_type _blockRank(const size_type& b, const uint8_t& code) const {
+    // the counts are 32-bit integers packed into the block's first words;
+    // they're copied out since they can't be accessed through a uint32_t
+    // pointer into uint64_t storage
+    uint32_t count;
+    std::memcpy(
+      &count,
+      reinterpret_cast<const char*>(_block(b)) + code * sizeof(uint32_t),
+      sizeof(uint32_t));
+    return _superblock_counts[(b / SUPERBLOCK_BLOCKS) * _codes + code] + count;
+  }
+
+  //! Gets the number of times a code occurs in the first i packed characters,
+  //  counting the terminal character's place.
+  size_type _packedRank(const size_type& i, const uint8_t& code) const {
+    const size_type b = i / _block_chars;
+    const uint64_t* words = _block(b) + _count_words;
+    size_type offset = i % _block_chars;
+    size_type rank = _blockRank(b, code);
+    for (; offset >= _word_chars; offset -= _word_chars, ++words) {
+      rank += std::popcount(_matches(*words, code));
+    }
+    if (offset > 0) {
+      const uint64_t prefix = (uint64_t(1) << (offset * _bits)) - 1;
+      rank += std::popcount(_matches(*words, code) & prefix);
+    }
+    return rank;
+  }
+
+  //! Gets the position of the kth packed occurrence of a code, counting the
+  //  terminal character's place.
+  size_type _packedSelect(size_type k, const uint8_t& code) const {
+    // the last block with fewer than k occurrences before it
+    size_type lo = 0, hi = _num_blocks;
+    while (hi - lo > 1) {
+      const size_type mid = lo + (hi - lo) / 2;
+      if (_blockRank(mid, code) < k) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+    k -= _blockRank(lo, code);
+    const uint64_t* words = _block(lo) + _count_words;
+    size_type i = lo * _block_chars;
+    uint64_t matches = _matches(*words, code);
+    for (size_type count; (count = std::popcount(matches)) < k;) {
+      k -= count;
+      i += _word_chars;
+      matches = _matches(*(++words), code);
+    }
+    for (; k > 1; --k) {
+      matches &= matches - 1;
+    }
+    return i + std::countr_zero(matches) / _bits;
+  }
+
+  //! Gets the code of the ith packed character.
+  uint8_t _code(const size_type& i) const {
+    const size_type offset = i % _block_chars;
+    const uint64_t word =
+      _block(i / _block_chars)[_count_words + offset / _word_chars];
+    return (word >> ((offset % _word_chars) * _bits)) & ((1 << _bits) - 1);
+  }
+
+public:
+
+  size_type sigma;
+
+  //! Packs the BWT of a compressed suffix array (CSA).
+  /*!
+   *  \param csa The CSA.
+   *
+   *  \throws std::invalid_argument If the text has more than 8 distinct
+   *    characters, not counting the terminal character.
+   */
+  template <class csa_type>
+  explicit PackedBwt(const csa_type& csa):
+    _size(csa.size()),
+    _terminator(0),
+    _terminator_rank(0),
+    _char_codes(256, NO_CODE),
+    sigma(csa.sigma)
+  {
+    if (sigma > 9) {
+      throw std::invalid_argument(
+        "a packed BWT supports at most 8 distinct characters");
+    }
+    _bits = sigma <= 5 ? 2 : 3;
+    _codes = size_type(1) << _bits;
+    _count_words = _codes / 2;  // 32-bit counts
+    _word_chars = 64 / _bits;
+    _block_chars = (BLOCK_WORDS - _count_words) * _word_chars;
+    // the last block holds the counts of the whole BWT
+    _num_blocks = _size / _block_chars + 1;
+
+    // the terminal character is comp 0 and the others are coded from 0
+    _code_chars.resize(_codes, 0);
+    for (size_type k = 1; k < sigma; ++k) {
+      _char_codes[csa.comp2char[k]] = k - 1;
+      _code_chars[k-1] = csa.comp2char[k];
+    }
+    _low_bits = 0;
+    for (size_type f = 0; f < _word_chars; ++f) {
+      _low_bits |= uint64_t(1) << (f * _bits);
+    }
+    _code_patterns.resize(_codes);
+    for (size_type code = 0; code < _codes; ++code) {
+      _code_patterns[code] = _low_bits * code;
+    }
+
+    // pack the characters and count them
+    _words.assign(_num_blocks * BLOCK_WORDS + BLOCK_WORDS - 1, 0);
+    _first_word = 0;
+    while ((reinterpret_cast<uintptr_t>(_words.data() + _first_word) % 64) != 0) {
+      _first_word += 1;
+    }
+    _superblock_counts.assign(
+      ((_num_blocks - 1) / SUPERBLOCK_BLOCKS + 1) * _codes, 0);
+    std::vector<size_type> counts(_codes, 0);
+    for (size_type b = 0; b < _num_blocks; ++b) {
+      uint64_t* block = _words.data() + _first_word + b * BLOCK_WORDS;
+      const size_type superblock = b / SUPERBLOCK_BLOCKS;
+      if (b % SUPERBLOCK_BLOCKS == 0) {
+        for (size_type code = 0; code < _codes; ++code) {
+          _superblock_counts[superblock * _codes + code] = counts[code];
+        }
+      }
+      for (size_type code = 0; code < _codes; ++code) {
+        const uint32_t block_count =
+          counts[code] - _superblock_counts[superblock * _codes + code];
+        std::memcpy(
+          reinterpret_cast<char*>(block) + code * sizeof(uint32_t),
+          &block_count,
+          sizeof(uint32_t));
+      }
+      const size_type begin = b * _block_chars;
+      const size_type end = std::min(begin + _block_chars, _size);
+      for (size_type i = begin; i < end; ++i) {
+        const value_type c = csa.bwt[i];
+        uint8_t code = 0;
+        if (csa.char2comp[c] == 0) {
+          _terminator = i;
+          _terminator_rank = counts[0];
+        } else {
+          code = _char_codes[c];
+        }
+        const size_type offset = i - begin;
+        block[_count_words + offset / _word_chars] |=
+          uint64_t(code) << ((offset % _word_chars) * _bits);
+        counts[code] += 1;
+      }
+    }
+  }
+
+  // the blocks are aligned relative to their vector's buffer
+  PackedBwt(const PackedBwt&) = delete;
+  PackedBwt& operator=(const PackedBwt&) = delete;
+
+  //! Gets the length of the BWT.
+  size_type size() const {
+    return _size;
+  }
+
+  //! Gets the number of bits each character is packed into.
+  size_type bitsPerCharacter() const {
+    return _bits;
+  }
+
+  //! Gets the number of bytes the packed BWT uses.
+  size_type sizeInBytes() const {
+    return _words.size() * sizeof(uint64_t) +
+      _superblock_counts.size() * sizeof(size_type) +
+      _char_codes.size() + _code_chars.size() +
+      _code_patterns.size() * sizeof(uint64_t);
+  }
+
+  //! Gets the ith BWT character.
+  value_type operator[](const size_type& i) const {
+    return i == _terminator ? 0 : _code_chars[_code(i)];
+  }
+
+  //! Counts the occurrences of a character in the first i BWT characters.
+  /*!
+   *  \param i The length of the BWT prefix.
+   *  \param c The character.
+   *  \return The number of occurrences.
+   */
+  size_type rank(const size_type& i, const value_type& c) const {
+    if (c == 0) {
+      return i > _terminator ? 1 : 0;
+    }
+    const uint8_t code = _char_codes[c];
+    if (code == NO_CODE) {
+      return 0;
+    }
+    return _packedRank(i, code) - (code == 0 && i > _terminator ? 1 : 0);
+  }
+
+  //! Gets the ith BWT character and its rank, i.e. its number of occurrences
+  //  before position i.
+  std::pair<size_type, value_type> inverse_select(const size_type& i) const {
+    if (i == _terminator) {
+      return {0, 0};
+    }
+    const uint8_t code = _code(i);
+    return {
+      _packedRank(i, code) - (code == 0 && i > _terminator ? 1 : 0),
+      _code_chars[code]
+    };
+  }
+
+  //! Gets the BWT position of the kth occurrence of a character.
+  /*!
+   *  \param k The occurrence, starting at 1.
+   *  \param c The character.
+   *  \return The position of the occurrence.
+   */
+  size_type select(const size_type& k, const value_type& c) const {
+    if (c == 0) {
+      return _terminator;
+    }
+    const uint8_t code = _char_codes[c];
+    // skip the terminal character's place
+    if (code == 0 && k > _terminator_rank) {
+      return _packedSelect(k+1, code);
+    }
+    return _packedSelect(k, code);
+  }
+
+  //! Computes the distinct characters in a BWT interval and their ranks at
+  //  its boundaries, like sdsl::interval_symbols. Every character's ranks are
+  //  computed, so the characters are output in alphabetical order.
+  /*!
+   *  \param i The begin position of the interval.
+   *  \param j The end position of the interval (exclusive).
+   *  \param k The number of distinct characters in the interval.
+   *  \param cs The distinct characters.
+   *  \param rank_c_i The rank of each character at position i.
+   *  \param rank_c_j The rank of each character at position j.
+   */
+  void intervalSymbols(
+    const size_type& i,
+    const size_type& j,
+    size_type& k,
+    std::vector<value_type>& cs,
+    std::vector<size_type>& rank_c_i,
+    std::vector<size_type>& rank_c_j) const
+  {
+    k = 0;
+    if (i == j) {
+      return;
+    }
+    if (i <= _terminator && _terminator < j) {
+      cs[k] = 0;
+      rank_c_i[k] = 0;
+      rank_c_j[k] = 1;
+      k += 1;
+    }
+    for (size_type code = 0; code + 1 < sigma; ++code) {
+      size_type rank_i = _packedRank(i, code);
+      size_type rank_j = _packedRank(j, code);
+      if (code == 0) {
+        rank_i -= i > _terminator ? 1 : 0;
+        rank_j -= j > _terminator ? 1 : 0;
+      }
+      if (rank_i != rank_j) {
+        cs[k] = _code_chars[code];
+        rank_c_i[k] = rank_i;
+        rank_c_j[k] = rank_j;
+        k += 1;
+      }
+    }
+  }
+
+};
+
+
+//! Overloads sdsl::interval_symbols for packed BWTs so it's found by
+//  argument-dependent lookup.
+inline void interval_symbols(
+  const PackedBwt& bwt,
+  PackedBwt::size_type i,
+  PackedBwt::size_type j,
+  PackedBwt::size_type& k,
+  std::vector<PackedBwt::value_type>& cs,
+  std::vector<PackedBwt::size_type>& rank_c_i,
+  std::vector<PackedBwt::size_type>& rank_c_j)
+{
+  bwt.intervalSymbols(i, j, k, cs, rank_c_i, rank_c_j);
+}
+
+
+//! A compressed suffix array (CSA) backed by a packed BWT. It can be used in
+//  place of sdsl::csa_wt when the text has a small alphabet, e.g. DNA.
+typedef SampledCsa<PackedBwt> PackedCsa;
+
+
+}
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDED_MR_CFG_POOL
+#define INCLUDED_MR_CFG_POOL
+
+#include <algorithm>  // max
+#include <barrier>
+#include <thread>
+#include <vector>
+
+
+namespace mr_cfg {
+
+
+//! A fixed set of threads that repeatedly run a task together. The threads
+//  are created once and wait on a barrier between tasks, so running a task
+//  costs two barrier phases rather than creating and joining threads, which
+//  matters when there are many small tasks, e.g. one per LCP value.
+class ThreadPool
+{
+
+private:
+
+  unsigned _num_threads;
+  std::vector<std::thread> _workers;
+  // every thread arrives at _start before a task and at _finish after it
+  std::barrier<> _start;
+  std::barrier<> _finish;
+  // the task being run, as a type-erased callable and its invoker
+  void* _task;
+  void (*_invoke)(void*, unsigned);
+  bool _stop;
+
+  //! Runs the tasks of one of the pool's threads until the pool is destroyed.
+  void _work(unsigned t) {
+    while (true) {
+      _start.arrive_and_wait();
+      if (_stop) {
+        return;
+      }
+      _invoke(_task, t);
+      _finish.arrive_and_wait();
+    }
+  }
+
+public:
+
+  //! Creates the pool's threads.
+  /*!
+   *  \param num_threads The number of threads that run each task, including
+   *    the thread that calls run.
+   */
+  explicit ThreadPool(unsigned num_threads):
+    _num_threads(std::max(1u, num_threads)),
+    _start(_num_threads),
+    _finish(_num_threads),
+    _task(NULL),
+    _invoke(NULL),
+    _stop(false)
+  {
+    for (unsigned t = 1; t < _num_threads; ++t) {
+      _workers.emplace_back([this, t]() { _work(t); });
+    }
+  }
+
+  // the threads point to the pool
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool() {
+    _stop = true;
+    _start.arrive_and_wait();
+    for (std::thread& worker: _workers) {
+      worker.join();
+    }
+  }
+
+  //! Gets the number of threads that run each task.
+  unsigned size() const {
+    return _num_threads;
+  }
+
+  //! Runs a task with every thread of the pool and waits for them to finish.
+  //  The calling thread runs the task as thread 0.
+  /*!
+   *  \param task A callable that takes the index of the thread running it.
+   */
+  template <class task_type>
+  void run(task_type& task) {
+    _task = &task;
+    _invoke = [](void* task, unsigned t) {
+      (*static_cast<task_type*>(task))(t);
+    };
+    _start.arrive_and_wait();
+    task(0);
+    _finish.arrive_and_wait();
+  }
+
+};
+
+
+}
+
+#endif
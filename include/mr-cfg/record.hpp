@@ -0,0 +1,275 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDED_MR_CFG_RECORD
+#define INCLUDED_MR_CFG_RECORD
+
+#include <algorithm>  // max
+#include <unordered_map>
+#include <vector>
+
+#include <sdsl/int_vector.hpp>
+
+#include "mr-cfg/identifier.hpp"
+#include "mr-cfg/lcp.hpp"
+#include "mr-cfg/maximal.hpp"
+
+
+namespace mr_cfg {
+
+
+//! A record of the maximal repeat LCP-intervals of a compressed suffix array
+//  (CSA), in the order they're computed, along with the metadata needed to
+//  build a grammar from them. Recording the intervals lets consumers that
+//  need them more than once, e.g. OptimalNestedIntervalStabber initialization
+//  and grammar construction, share a single LCP-interval enumeration.
+//
+//  Each interval's begin, end, repeat ID, repeat length, and the text
+//  position of its first suffix are stored in bit-compressed vectors.
+template <class csa_wt, typename size_type = typename csa_wt::size_type>
+class MaximalIntervalRecord
+{
+
+private:
+
+  sdsl::int_vector<> _begins;
+  sdsl::int_vector<> _ends;
+  sdsl::int_vector<> _ids;
+  sdsl::int_vector<> _lengths;
+  sdsl::int_vector<> _positions;
+  // the size of the CSA the intervals were computed from
+  size_type _csa_size;
+  // the ID that will be assigned to the next repeat, i.e. the start rule
+  id_type _next_id;
+  // the memory used by the LCP-interval enumeration the record was built by
+  LcpIntervalStatistics _lcp_statistics;
+
+  //! Computes the LCP-intervals of the CSA and records the maximal ones. IDs
+  //  and lengths are computed the same way as if the intervals were consumed
+  //  as they're computed.
+  //
+  //  O(n) time, excluding CSA-specific operations, where n is the size of the
+  //  CSA.
+  /*!
+   *  \param csa The CSA to compute LCP-intervals for.
+   *  \param lcp_intervals The source of the CSA's LCP-intervals.
+   */
+  template <LcpIntervalSource source_type>
+  void initialize(const csa_wt& csa, source_type& lcp_intervals) {
+
+    const size_type n = csa.size();
+    // every value is at most the number of LCP-intervals plus sigma
+    reset(n, 2*n + csa.sigma);
+
+    // initialize a position-to-ID map and the supporting length map
+    OnlineLcpIdentifiers repeat_ids(csa);
+    std::unordered_map<id_type, size_type> repeat_lengths;
+
+    // compute LCP-intervals in order
+    for_each_lcp_interval(lcp_intervals, [&](const auto& interval) {
+      // skip the length 0 LCP-interval
+      if (interval.lcp == 0) {
+        return;
+      }
+      // compute the repeat's ID and length
+      id_type repeat_id =
+        repeat_ids.getId(interval.lcp, interval.begin, interval.end);
+      repeat_lengths[repeat_id] += 1;
+      // record the interval if it's maximal
+      if (interval.left_extensions > 1) {
+        push_back(
+          interval.begin, interval.end, repeat_id, repeat_lengths[repeat_id],
+          csa[interval.begin]);
+        // the repeat's length is final once it's maximal
+        repeat_lengths.erase(repeat_id);
+        // erase the ID to guarantee left-extensions will use a different ID
+        repeat_ids.removeId(interval.lcp, interval.begin, interval.end);
+      }
+    });
+    _next_id = repeat_ids.getNextId();
+
+    _compress();
+
+  }
+
+  //! Records the maximal LCP-intervals of the CSA, whose IDs and lengths are
+  //  computed by the enumerator without doing any work for the intervals that
+  //  aren't maximal.
+  /*!
+   *  \param csa The CSA to compute LCP-intervals for.
+   *  \param repeats The source of the CSA's maximal repeat LCP-intervals.
+   */
+  void initialize(const csa_wt& csa, MaximalRepeatEnumerator<csa_wt>& repeats) {
+    const size_type n = csa.size();
+    reset(n, 2*n + csa.sigma);
+    for_each_lcp_interval(repeats, [&](const auto& repeat) {
+      push_back(
+        repeat.begin, repeat.end, repeat.id, repeat.length, repeat.position);
+    });
+    _next_id = repeats.getNextId();
+    _compress();
+  }
+
+  //! Bit-compresses the recorded values.
+  void _compress() {
+    sdsl::util::bit_compress(_begins);
+    sdsl::util::bit_compress(_ends);
+    sdsl::util::bit_compress(_ids);
+    sdsl::util::bit_compress(_lengths);
+    sdsl::util::bit_compress(_positions);
+  }
+
+public:
+
+  //! Records the maximal LCP-intervals of a CSA.
+  /*!
+   *  \param csa The CSA.
+   *  \param num_threads The number of threads to compute LCP-intervals with.
+   */
+  MaximalIntervalRecord(const csa_wt& csa, unsigned num_threads = 1) {
+    LcpIntervalEnumerator<csa_wt> lcp_intervals(csa, num_threads);
+    initialize(csa, lcp_intervals);
+    _lcp_statistics = lcp_intervals.statistics();
+  }
+
+  //! Records the maximal LCP-intervals of a CSA computed by a
+  //  MaximalRepeatEnumerator.
+  /*!
+   *  \param csa The CSA.
+   *  \param repeats The source of the CSA's maximal repeat LCP-intervals.
+   */
+  MaximalIntervalRecord(const csa_wt& csa, MaximalRepeatEnumerator<csa_wt>& repeats) {
+    initialize(csa, repeats);
+    _lcp_statistics = repeats.statistics();
+  }
+
+  //! Records the maximal LCP-intervals of a CSA. The enumeration's statistics
+  //  are kept if the source reports any.
+  /*!
+   *  \param csa The CSA.
+   *  \param lcp_intervals The source of the CSA's LCP-intervals.
+   */
+  template <LcpIntervalSource source_type>
+  MaximalIntervalRecord(const csa_wt& csa, source_type& lcp_intervals) {
+    initialize(csa, lcp_intervals);
+    if constexpr (requires { lcp_intervals.statistics(); }) {
+      _lcp_statistics = lcp_intervals.statistics();
+    }
+  }
+
+  //! Constructs an empty record for a CSA of the given size, e.g. to record
+  //  intervals that weren't computed from a CSA.
+  /*!
+   *  \param csa_size The size of the CSA.
+   *  \param max_value The largest value that will be recorded.
+   */
+  MaximalIntervalRecord(const size_type& csa_size, const size_type& max_value) {
+    reset(csa_size, max_value);
+  }
+
+  //! Empties the record and sets the size of the CSA its intervals are from.
+  /*!
+   *  \param csa_size The size of the CSA.
+   *  \param max_value The largest value that will be recorded.
+   */
+  void reset(const size_type& csa_size, const size_type& max_value) {
+    _csa_size = csa_size;
+    _next_id = 0;
+    _lcp_statistics = LcpIntervalStatistics();
+    const uint8_t width = sdsl::bits::hi(max_value) + 1;
+    _begins = sdsl::int_vector<>(0, 0, width);
+    _ends = sdsl::int_vector<>(0, 0, width);
+    _ids = sdsl::int_vector<>(0, 0, width);
+    _lengths = sdsl::int_vector<>(0, 0, width);
+    _positions = sdsl::int_vector<>(0, 0, width);
+  }
+
+  //! Records a maximal repeat LCP-interval. Intervals must be recorded in the
+  //  order they're computed, i.e. shortest LCP-value first.
+  /*!
+   *  \param begin The begin position of the interval.
+   *  \param end The end position of the interval.
+   *  \param id The repeat ID of the interval.
+   *  \param length The length of the interval's repeat.
+   *  \param position The text position of the first suffix in the interval.
+   */
+  void push_back(
+    const size_type& begin,
+    const size_type& end,
+    const id_type& id,
+    const size_type& length,
+    const size_type& position)
+  {
+    _begins.push_back(begin);
+    _ends.push_back(end);
+    _ids.push_back(id);
+    _lengths.push_back(length);
+    _positions.push_back(position);
+    _next_id = std::max<id_type>(_next_id, id + 1);
+  }
+
+  //! Gets the size of the CSA the intervals were computed from.
+  size_type csaSize() const {
+    return _csa_size;
+  }
+
+  //! Gets the number of maximal repeat LCP-intervals.
+  size_type size() const {
+    return _begins.size();
+  }
+
+  //! Gets the begin position of the kth interval.
+  size_type begin(const size_type& k) const {
+    return _begins[k];
+  }
+
+  //! Gets the end position of the kth interval.
+  size_type end(const size_type& k) const {
+    return _ends[k];
+  }
+
+  //! Gets the repeat ID of the kth interval.
+  id_type id(const size_type& k) const {
+    return _ids[k];
+  }
+
+  //! Gets the length of the repeat of the kth interval.
+  size_type length(const size_type& k) const {
+    return _lengths[k];
+  }
+
+  //! Gets the text position of the first suffix in the kth interval.
+  size_type position(const size_type& k) const {
+    return _positions[k];
+  }
+
+  //! Gets the ID that wasn't assigned to any repeat, i.e. the next ID.
+  id_type getNextId() const {
+    return _next_id;
+  }
+
+  //! Gets statistics about the memory used by the LCP-interval enumeration
+  //  the record was built by.
+  const LcpIntervalStatistics& lcpStatistics() const {
+    return _lcp_statistics;
+  }
+
+};
+
+
+}
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDED_MR_CFG_RLBWT
+#define INCLUDED_MR_CFG_RLBWT
+
+#include <algorithm>  // lower_bound, min
+#include <cstdint>
+#include <utility>  // pair
+#include <vector>
+
+#include <sdsl/construct.hpp>
+#include <sdsl/int_vector.hpp>
+#include <sdsl/sd_vector.hpp>
+#include <sdsl/wavelet_trees.hpp>
+
+#include "mr-cfg/sampled.hpp"
+
+
+namespace mr_cfg {
+
+
+//! A run-length encoded Burrows-Wheeler Transform (BWT) that supports the
+//  wavelet tree operations LCP-interval enumeration uses, i.e. access, rank,
+//  select, and interval_symbols.
+//
+//  The BWT is stored as the positions its r runs start at, in a sparse bit
+//  vector, a wavelet tree of the runs' characters, and, for each character,
+//  the number of times it occurs in its first k runs. Once built, this takes
+//  O(r log n) bits instead of the O(n log sigma) bits of a wavelet tree of the
+//  BWT; it's built from a CSA, so construction isn't in O(r log n) bits.
+class RunLengthBwt
+{
+
+public:
+
+  typedef uint64_t size_type;
+  typedef uint8_t value_type;
+
+private:
+
+  size_type _size;
+  // the BWT position each run starts at
+  sdsl::sd_vector<> _run_starts;
+  sdsl::sd_vector<>::rank_1_type _run_rank;
+  sdsl::sd_vector<>::select_1_type _run_select;
+  // the character of each run
+  sdsl::wt_huff<> _run_heads;
+  // for each character, the number of times it occurs in its first k runs
+  std::vector<sdsl::int_vector<>> _run_offsets;
+
+  //! Gets the run the ith BWT character is in.
+  size_type _runOf(const size_type& i) const {
+    return _run_rank(std::min<size_type>(i+1, _run_starts.size())) - 1;
+  }
+
+  //! Gets the BWT position the kth run starts at.
+  size_type _runStart(const size_type& k) const {
+    return _run_select(k+1);
+  }
+
+public:
+
+  size_type sigma;
+
+  //! Run-length encodes the BWT of a compressed suffix array (CSA).
+  /*!
+   *  \param csa The CSA.
+   */
+  template <class csa_type>
+  explicit RunLengthBwt(const csa_type& csa): _size(csa.size()), sigma(csa.sigma) {
+    std::vector<size_type> starts;
+    std::vector<std::vector<size_type>> offsets(256);
+    std::vector<value_type> heads;
+    for (size_type i = 0; i < _size; ++i) {
+      const value_type c = csa.bwt[i];
+      if (heads.empty() || heads.back() != c) {
+        starts.push_back(i);
+        heads.push_back(c);
+        if (offsets[c].empty()) {
+          offsets[c].push_back(0);
+        }
+        offsets[c].push_back(offsets[c].back());
+      }
+      offsets[c].back() += 1;
+    }
+    _run_starts = sdsl::sd_vector<>(starts.begin(), starts.end());
+    _run_rank = sdsl::sd_vector<>::rank_1_type(&_run_starts);
+    _run_select = sdsl::sd_vector<>::select_1_type(&_run_starts);
+    sdsl::int_vector<8> run_heads(heads.size());
+    for (size_type k = 0; k < heads.size(); ++k) {
+      run_heads[k] = heads[k];
+    }
+    // the run heads are serialized for construction, so they're read back as
+    // an int_vector rather than as plain bytes
+    sdsl::construct_im(_run_heads, run_heads, 0);
+    _run_offsets.resize(offsets.size());
+    for (size_type c = 0; c < offsets.size(); ++c) {
+      _run_offsets[c] = sdsl::int_vector<>(offsets[c].size(), 0);
+      for (size_type k = 0; k < offsets[c].size(); ++k) {
+        _run_offsets[c][k] = offsets[c][k];
+      }
+      sdsl::util::bit_compress(_run_offsets[c]);
+    }
+  }
+
+  // the rank and select supports point to the run starts
+  RunLengthBwt(const RunLengthBwt&) = delete;
+  RunLengthBwt& operator=(const RunLengthBwt&) = delete;
+
+  //! Gets the length of the BWT.
+  size_type size() const {
+    return _size;
+  }
+
+  //! Gets the number of runs in the BWT.
+  size_type runs() const {
+    return _run_heads.size();
+  }
+
+  //! Gets the number of bytes the run-length encoding uses.
+  size_type sizeInBytes() const {
+    size_type bytes = sdsl::size_in_bytes(_run_starts) +
+      sdsl::size_in_bytes(_run_heads);
+    for (const sdsl::int_vector<>& offsets: _run_offsets) {
+      bytes += sdsl::size_in_bytes(offsets);
+    }
+    return bytes;
+  }
+
+  //! Gets the ith BWT character.
+  value_type operator[](const size_type& i) const {
+    return _run_heads[_runOf(i)];
+  }
+
+  //! Counts the occurrences of a character in the first i BWT characters.
+  /*!
+   *  \param i The length of the BWT prefix.
+   *  \param c The character.
+   *  \return The number of occurrences.
+   */
+  size_type rank(const size_type& i, const value_type& c) const {
+    if (i == 0 || _run_offsets[c].empty()) {
+      return 0;
+    }
+    const size_type j = _runOf(i-1);
+    const size_type k = _run_heads.rank(j, c);
+    return _run_offsets[c][k] + (_run_heads[j] == c ? i - _runStart(j) : 0);
+  }
+
+  //! Gets the ith BWT character and its rank, i.e. its number of occurrences
+  //  before position i.
+  std::pair<size_type, value_type> inverse_select(const size_type& i) const {
+    const size_type j = _runOf(i);
+    const auto [k, c] = _run_heads.inverse_select(j);
+    return {_run_offsets[c][k] + i - _runStart(j), c};
+  }
+
+  //! Gets the BWT position of the kth occurrence of a character.
+  /*!
+   *  \param k The occurrence, starting at 1.
+   *  \param c The character.
+   *  \return The position of the occurrence.
+   */
+  size_type select(const size_type& k, const value_type& c) const {
+    const sdsl::int_vector<>& offsets = _run_offsets[c];
+    // the c-run the occurrence is in
+    const size_type j =
+      std::lower_bound(offsets.begin(), offsets.end(), k) - offsets.begin() - 1;
+    return _runStart(_run_heads.select(j+1, c)) + (k - offsets[j] - 1);
+  }
+
+  //! Computes the distinct characters in a BWT interval and their ranks at
+  //  its boundaries, like sdsl::interval_symbols. The characters are computed
+  //  from the runs the interval overlaps and the ranks are then adjusted for
+  //  the parts of the first and last runs outside the interval.
+  /*!
+   *  \param i The begin position of the interval.
+   *  \param j The end position of the interval (exclusive).
+   *  \param k The number of distinct characters in the interval.
+   *  \param cs The distinct characters.
+   *  \param rank_c_i The rank of each character at position i.
+   *  \param rank_c_j The rank of each character at position j.
+   */
+  void intervalSymbols(
+    const size_type& i,
+    const size_type& j,
+    size_type& k,
+    std::vector<value_type>& cs,
+    std::vector<size_type>& rank_c_i,
+    std::vector<size_type>& rank_c_j) const
+  {
+    if (i == j) {
+      k = 0;
+      return;
+    }
+    const size_type first_run = _runOf(i);
+    const size_type last_run = _runOf(j-1);
+    sdsl::interval_symbols(
+        _run_heads,
+        first_run, last_run+1,
+        k, cs,
+        rank_c_i, rank_c_j
+      );
+    const value_type first_head = _run_heads[first_run];
+    const value_type last_head = _run_heads[last_run];
+    for (size_type t = 0; t < k; ++t) {
+      const value_type c = cs[t];
+      const sdsl::int_vector<>& offsets = _run_offsets[c];
+      rank_c_i[t] = offsets[rank_c_i[t]] +
+        (c == first_head ? i - _runStart(first_run) : 0);
+      // the last run's characters are counted up to position j
+      if (c == last_head) {
+        rank_c_j[t] = offsets[rank_c_j[t]-1] + j - _runStart(last_run);
+      } else {
+        rank_c_j[t] = offsets[rank_c_j[t]];
+      }
+    }
+  }
+
+};
+
+
+//! Overloads sdsl::interval_symbols for run-length encoded BWTs so it's found
+//  by argument-dependent lookup.
+inline void interval_symbols(
+  const RunLengthBwt& bwt,
+  RunLengthBwt::size_type i,
+  RunLengthBwt::size_type j,
+  RunLengthBwt::size_type& k,
+  std::vector<RunLengthBwt::value_type>& cs,
+  std::vector<RunLengthBwt::size_type>& rank_c_i,
+  std::vector<RunLengthBwt::size_type>& rank_c_j)
+{
+  bwt.intervalSymbols(i, j, k, cs, rank_c_i, rank_c_j);
+}
+
+
+//! A compressed suffix array (CSA) backed by a run-length encoded BWT. It can
+//  be used in place of sdsl::csa_wt when the text is highly repetitive, i.e.
+//  when its BWT has few runs.
+typedef SampledCsa<RunLengthBwt> RunLengthCsa;
+
+
+}
+
+#endif
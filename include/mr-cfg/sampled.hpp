@@ -0,0 +1,288 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDED_MR_CFG_SAMPLED
+#define INCLUDED_MR_CFG_SAMPLED
+
+#include <algorithm>  // sort, upper_bound
+#include <atomic>
+#include <cstdint>
+#include <utility>  // pair
+#include <vector>
+
+#include <sdsl/construct.hpp>
+#include <sdsl/csa_wt.hpp>
+#include <sdsl/int_vector.hpp>
+#include <sdsl/sd_vector.hpp>
+
+
+namespace mr_cfg {
+
+
+//! A compressed suffix array (CSA) backed by a BWT data-structure other than
+//  an sdsl wavelet tree, e.g. RunLengthBwt. It has the same interface as
+//  sdsl::csa_wt as far as LCP-interval enumeration and grammar construction
+//  are concerned, so it can be used in its place. The BWT data-structure must
+//  be constructible from a CSA and provide size, access, inverse_select,
+//  select, sizeInBytes, sigma, and an interval_symbols overload.
+//
+//  The suffix array (SA) is sampled at every sa_sample_rate-th text position
+//  and other values are computed by LF-mapping to a sample. The inverse SA
+//  (ISA) is sampled every isa_sample_rate-th text position and other values
+//  are computed by Psi-mapping from the preceding sample; the last value each
+//  thread computed is cached so that accessing the ISA in text order, as
+//  grammar construction does, takes one Psi-mapping per value. The caches are
+//  thread-local, so the ISA and text can be accessed by multiple threads at
+//  once.
+//
+//  The BWT data-structure and samples are computed from a temporary
+//  sdsl::csa_wt, so construction takes as much memory as a csa_wt does; only
+//  the constructed CSA takes the BWT data-structure's space plus the samples.
+template <class bwt_type>
+class SampledCsa
+{
+
+public:
+
+  typedef uint64_t size_type;
+  typedef uint8_t value_type;
+  typedef bwt_type wavelet_tree_type;
+
+  //! Accesses the BWT.
+  struct bwt_accessor {
+    const SampledCsa* csa;
+    value_type operator[](const size_type& i) const {
+      return csa->wavelet_tree[i];
+    }
+    size_type size() const { return csa->size(); }
+  };
+
+  //! Computes the LF-mapping.
+  struct lf_accessor {
+    const SampledCsa* csa;
+    size_type operator[](const size_type& i) const {
+      return csa->_lf(i);
+    }
+    size_type size() const { return csa->size(); }
+  };
+
+  //! Accesses the ISA.
+  struct isa_accessor {
+    const SampledCsa* csa;
+    size_type operator[](const size_type& i) const {
+      return csa->_isa(i);
+    }
+    size_type size() const { return csa->size(); }
+  };
+
+  //! Accesses the text, including its terminal character.
+  struct text_accessor {
+    const SampledCsa* csa;
+    value_type operator[](const size_type& i) const {
+      return csa->_first(csa->_isa(i));
+    }
+    size_type size() const { return csa->size(); }
+  };
+
+  bwt_type wavelet_tree;
+  size_type sigma;
+  std::vector<size_type> C;
+  std::vector<size_type> char2comp;
+  std::vector<value_type> comp2char;
+  const bwt_accessor bwt;
+  const lf_accessor lf;
+  const isa_accessor isa;
+  const text_accessor text;
+
+private:
+
+  size_type _sa_sample_rate;
+  size_type _isa_sample_rate;
+  // the SA positions that are sampled and their values divided by the rate
+  sdsl::sd_vector<> _sa_marks;
+  sdsl::sd_vector<>::rank_1_type _sa_rank;
+  sdsl::int_vector<> _sa_samples;
+  // the ISA values of every isa_sample_rate-th text position
+  sdsl::int_vector<> _isa_samples;
+  // identifies the index in the threads' ISA caches; unlike the address of
+  // the index, it isn't reused by later indexes
+  uint64_t _isa_cache_id;
+
+  //! The last ISA value a thread computed.
+  struct IsaCache
+  {
+    // the _isa_cache_id of the index the value is from; 0 means none
+    uint64_t id = 0;
+    size_type i = 0;
+    size_type value = 0;
+  };
+
+  //! Gets a new ISA cache ID.
+  static uint64_t _nextIsaCacheId() {
+    static std::atomic<uint64_t> next_id(1);
+    return next_id.fetch_add(1);
+  }
+
+  //! Gets the first character of the ith suffix in the SA.
+  value_type _first(const size_type& i) const {
+    const size_type k = std::upper_bound(C.begin(), C.end(), i) - C.begin() - 1;
+    return comp2char[k];
+  }
+
+  //! Maps the ith suffix in the SA to the suffix one character longer.
+  size_type _lf(const size_type& i) const {
+    const auto [rank, c] = wavelet_tree.inverse_select(i);
+    return C[char2comp[c]] + rank;
+  }
+
+  //! Maps the ith suffix in the SA to the suffix one character shorter.
+  size_type _psi(const size_type& i) const {
+    const size_type k = std::upper_bound(C.begin(), C.end(), i) - C.begin() - 1;
+    return wavelet_tree.select(i - C[k] + 1, comp2char[k]);
+  }
+
+  //! Gets the ISA value of the ith text position.
+  size_type _isa(const size_type& i) const {
+    static thread_local IsaCache cache;
+    const size_type sample = i / _isa_sample_rate;
+    if (cache.id != _isa_cache_id || cache.i > i ||
+        cache.i < sample * _isa_sample_rate)
+    {
+      cache.id = _isa_cache_id;
+      cache.i = sample * _isa_sample_rate;
+      cache.value = _isa_samples[sample];
+    }
+    for (; cache.i < i; ++cache.i) {
+      cache.value = _psi(cache.value);
+    }
+    return cache.value;
+  }
+
+public:
+
+  //! Builds the index from a CSA of the text.
+  /*!
+   *  \param csa The CSA.
+   *  \param sa_sample_rate The SA sample rate.
+   *  \param isa_sample_rate The ISA sample rate.
+   */
+  template <class csa_type>
+  SampledCsa(
+    const csa_type& csa,
+    size_type sa_sample_rate = 32,
+    size_type isa_sample_rate = 64):
+    wavelet_tree(csa),
+    sigma(csa.sigma),
+    C(sigma+1),
+    char2comp(256, 0),
+    comp2char(sigma),
+    bwt{this},
+    lf{this},
+    isa{this},
+    text{this},
+    _sa_sample_rate(sa_sample_rate),
+    _isa_sample_rate(isa_sample_rate),
+    _isa_cache_id(_nextIsaCacheId())
+  {
+    const size_type n = csa.size();
+    for (size_type k = 0; k <= sigma; ++k) {
+      C[k] = csa.C[k];
+    }
+    for (size_type k = 0; k < sigma; ++k) {
+      comp2char[k] = csa.comp2char[k];
+      char2comp[comp2char[k]] = k;
+    }
+    // sample the SA and ISA by walking the text backwards with LF
+    std::vector<std::pair<size_type, size_type>> sa_samples;
+    _isa_samples = sdsl::int_vector<>((n + isa_sample_rate - 1) / isa_sample_rate, 0);
+    size_type r = 0;  // the terminal character's suffix
+    for (size_type p = n; p-- > 0;) {
+      if (p % _sa_sample_rate == 0) {
+        sa_samples.emplace_back(r, p / _sa_sample_rate);
+      }
+      if (p % _isa_sample_rate == 0) {
+        _isa_samples[p / _isa_sample_rate] = r;
+      }
+      r = csa.lf[r];
+    }
+    std::sort(sa_samples.begin(), sa_samples.end());
+    std::vector<size_type> marks(sa_samples.size());
+    _sa_samples = sdsl::int_vector<>(sa_samples.size(), 0);
+    for (size_type k = 0; k < sa_samples.size(); ++k) {
+      marks[k] = sa_samples[k].first;
+      _sa_samples[k] = sa_samples[k].second;
+    }
+    _sa_marks = sdsl::sd_vector<>(marks.begin(), marks.end());
+    _sa_rank = sdsl::sd_vector<>::rank_1_type(&_sa_marks);
+    sdsl::util::bit_compress(_sa_samples);
+    sdsl::util::bit_compress(_isa_samples);
+  }
+
+  //! Builds the index from a text. A temporary sdsl::csa_wt of the text is
+  //  built first, so construction uses as much memory as that of a csa_wt.
+  /*!
+   *  \param text The text.
+   *  \param sa_sample_rate The SA sample rate.
+   *  \param isa_sample_rate The ISA sample rate.
+   */
+  SampledCsa(
+    const sdsl::int_vector<8>& text,
+    size_type sa_sample_rate = 32,
+    size_type isa_sample_rate = 64):
+    SampledCsa(_construct(text), sa_sample_rate, isa_sample_rate) { }
+
+  // the accessors and supports point to the index
+  SampledCsa(const SampledCsa&) = delete;
+  SampledCsa& operator=(const SampledCsa&) = delete;
+
+  //! Gets the size of the SA, i.e. the length of the text plus one.
+  size_type size() const {
+    return wavelet_tree.size();
+  }
+
+  //! Gets the number of bytes the index uses.
+  size_type sizeInBytes() const {
+    return wavelet_tree.sizeInBytes() +
+      sdsl::size_in_bytes(_sa_marks) +
+      sdsl::size_in_bytes(_sa_samples) +
+      sdsl::size_in_bytes(_isa_samples) +
+      (C.size() + char2comp.size()) * sizeof(size_type) + comp2char.size();
+  }
+
+  //! Gets the ith SA value.
+  size_type operator[](size_type i) const {
+    size_type steps = 0;
+    while (i >= _sa_marks.size() || !_sa_marks[i]) {
+      i = _lf(i);
+      steps += 1;
+    }
+    return _sa_samples[_sa_rank(i)] * _sa_sample_rate + steps;
+  }
+
+private:
+
+  static sdsl::csa_wt<sdsl::wt_huff<>> _construct(const sdsl::int_vector<8>& text) {
+    sdsl::csa_wt<sdsl::wt_huff<>> csa;
+    sdsl::construct_im(csa, text);
+    return csa;
+  }
+
+};
+
+
+}
+
+#endif
@@ -18,6 +18,7 @@
 #define INCLUDED_MR_CFG_TIMER
 
 #include <chrono>
+#include <iostream>
 
 
 namespace mr_cfg {
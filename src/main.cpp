@@ -16,11 +16,17 @@
 
 #include <algorithm>  // min
 #include <iostream>
+#include <limits>
+#include <stdexcept>  // invalid_argument, logic_error, out_of_range
+#include <string>  // stoul
+#include <type_traits>  // decay_t, is_same_v
 
 #include <sdsl/construct.hpp>
 #include <sdsl/csa_wt.hpp>
 
 #include "mr-cfg/cfg.hpp"
+#include "mr-cfg/cost.hpp"
+#include "mr-cfg/csa.hpp"
 #include "mr-cfg/file.hpp"
 #include "mr-cfg/timer.hpp"
 
@@ -29,8 +35,60 @@ using namespace sdsl;
 using namespace mr_cfg;
 
 
-void usage(int argc, char* argv[]) {
-  cerr << "Usage: " << argv[0] << " {OPTIMAL|ONLINE|FAST} <FILE>" << endl;
+void usage(char* argv[]) {
+  cerr << "Usage: " << argv[0] << " {OPTIMAL|ONLINE|FAST|LSM|CONCURRENT|AUTO} <FILE> [THREADS] [{CSA|MAXIMAL|LCP}]"
+       << " [{WT_HUFF|WT_INT|WT_BLCD|WT_HUFF_RRR|RLBWT|PACKED}[:{8|32|128}]]" << endl;
+}
+
+
+//! Computes a CFG from a CSA, outputs statistics about it, and prints it.
+template <class csa_type>
+void computeCfg(
+  const csa_type& csa,
+  string algorithm,
+  const unsigned num_threads,
+  const string& interval_source,
+  Timer& timer)
+{
+  typedef typename csa_type::size_type size_type;
+
+  // choose the interval stabbing algorithm
+  if (algorithm.compare("AUTO") == 0) {
+    timer.startTask();
+    cout << "choosing interval stabbing algorithm" << endl;
+    algorithm = chooseNestedIntervalStabber(csa, cout, num_threads);
+    timer.endTask();
+  }
+
+  // compute the context-free grammar
+  timer.startTask();
+  cout << "copmuting CFG" << endl;
+  LcpIntervalStatistics lcp_statistics;
+  auto [cfg, start_rule] =
+    csaToCfg(csa, algorithm, num_threads, &lcp_statistics, interval_source);
+
+  size_type total_size = csa.sigma;
+  for (const auto& [rule, production] : cfg) {
+    total_size += production.size();
+  }
+  cout << "\tnumber of rules: " << cfg.size() + csa.sigma << endl;
+  cout << "\tstart rule size: " << cfg[start_rule].size() << endl;
+  cout << "\ttotal non-start size: " << total_size - cfg[start_rule].size() << endl;
+  cout << "\ttotal size: " << total_size << endl;
+  if (interval_source.compare("LCP") != 0) {
+    cout << "\tpeak LCP-interval queue size: " << lcp_statistics.peak_queue_size
+         << " (" << lcp_statistics.peak_queue_bytes << " bytes)" << endl;
+    cout << "\tLCP values stored in bit vectors: "
+         << lcp_statistics.bit_vector_levels << " ("
+         << lcp_statistics.bit_vector_bytes << " bytes)" << endl;
+  }
+  timer.endTask();
+
+  // regenerate the input file from the CFG for verification
+  timer.startTask();
+  cout << "printing CFG" << endl;
+  printCfg(csa, cfg, start_rule);
+  timer.endTask();
 }
 
 
@@ -39,15 +97,45 @@ int main(int argc, char* argv[])
 
   // check the command-line arguments
   if (argc < 3) {
-    usage(argc, argv);
+    usage(argv);
     return 1;
   }
-  const string algorithm = argv[1];
+  string algorithm = argv[1];
   if (algorithm.compare("OPTIMAL") != 0 &&
       algorithm.compare("ONLINE") != 0 &&
-      algorithm.compare("FAST") != 0)
+      algorithm.compare("FAST") != 0 &&
+      algorithm.compare("LSM") != 0 &&
+      algorithm.compare("CONCURRENT") != 0 &&
+      algorithm.compare("AUTO") != 0)
   {
-    usage(argc, argv);
+    usage(argv);
+    return 1;
+  }
+  unsigned num_threads = 1;
+  if (argc > 3) {
+    // the whole argument must be a number that fits in an unsigned int
+    try {
+      const string threads = argv[3];
+      size_t length;
+      const unsigned long value = stoul(threads, &length);
+      if (length != threads.size() || value > numeric_limits<unsigned>::max()) {
+        throw out_of_range(threads);
+      }
+      num_threads = value;
+    } catch (const std::logic_error& e) {  // invalid_argument or out_of_range
+      usage(argv);
+      return 1;
+    }
+  }
+  const string interval_source = argc > 4 ? argv[4] : "CSA";
+  const string index = argc > 5 ? argv[5] : "WT_HUFF";
+  if (num_threads == 0 ||
+      (interval_source.compare("CSA") != 0 &&
+       interval_source.compare("MAXIMAL") != 0 &&
+       interval_source.compare("LCP") != 0) ||
+      !isCsaConfiguration(index))
+  {
+    usage(argv);
     return 1;
   }
 
@@ -61,55 +149,45 @@ int main(int argc, char* argv[])
   int_vector<8> text = load_text(filepath);
   timer.endTask();
 
-  // construct the Compressed Suffix Array (Wavelet Tree of a Burrows-Wheeler
-  // Transform)
+  // construct the Compressed Suffix Array (e.g. Wavelet Tree of a
+  // Burrows-Wheeler Transform) and compute the CFG with it
   timer.startTask();
   cout << "building CSA" << endl;
-  csa_wt<wt_huff<>> csa;
-  construct_im(csa, text);
-  typedef csa_wt<wt_huff<>>::size_type size_type;
-
-  cout << "\tcsa size: " << csa.size() << endl;
-  cout << "\talphabet: " << csa.sigma << endl;
-  cout << "\twavelet tree size: " << csa.wavelet_tree.size() << endl;
-  //cout << "bits size: " << run_bits.size() << endl;
-  //cout << "i\tSA\tT[SA[i]..]" << endl;
-  //for (size_type i = 0; i < csa.size(); ++i) {
-  //  auto sa = csa[i];
-  //  cout << i << "\t" << sa << "\t";
-  //  while (sa < min(csa[i]+20, text.size())) {
-  //    char c = text[sa];
-  //    if (c == '\r' || c == '\n') {
-  //      cout << "\\n";
-  //    } else {
-  //      cout << c;
-  //    }
-  //    sa += 1;
-  //  }
-  //  cout << endl;
-  //}
-  timer.endTask();
-
-  // compute the context-free grammar
-  timer.startTask();
-  cout << "copmuting CFG" << endl;
-  auto [cfg, start_rule] = csaToCfg(csa, algorithm);
-
-  size_type total_size = csa.sigma;
-  for (const auto& [rule, production] : cfg) {
-    total_size += production.size();
+  try {
+    withCsa(index, text, [&](const auto& csa) {
+      cout << "\tcsa size: " << csa.size() << endl;
+      cout << "\talphabet: " << csa.sigma << endl;
+      cout << "\tcsa bytes: " << csaSizeInBytes(csa) << endl;
+      if constexpr (std::is_same_v<std::decay_t<decltype(csa)>, RunLengthCsa>) {
+        cout << "\tBWT runs: " << csa.wavelet_tree.runs() << endl;
+      } else if constexpr (std::is_same_v<std::decay_t<decltype(csa)>, PackedCsa>) {
+        cout << "\tbits per character: " << csa.wavelet_tree.bitsPerCharacter() << endl;
+      } else {
+        cout << "\twavelet tree size: " << csa.wavelet_tree.size() << endl;
+      }
+      //cout << "bits size: " << run_bits.size() << endl;
+      //cout << "i\tSA\tT[SA[i]..]" << endl;
+      //for (size_type i = 0; i < csa.size(); ++i) {
+      //  auto sa = csa[i];
+      //  cout << i << "\t" << sa << "\t";
+      //  while (sa < min(csa[i]+20, text.size())) {
+      //    char c = text[sa];
+      //    if (c == '\r' || c == '\n') {
+      //      cout << "\\n";
+      //    } else {
+      //      cout << c;
+      //    }
+      //    sa += 1;
+      //  }
+      //  cout << endl;
+      //}
+      timer.endTask();
+      computeCfg(csa, algorithm, num_threads, interval_source, timer);
+    });
+  } catch (const std::invalid_argument& e) {
+    cerr << index << ": " << e.what() << endl;
+    return 1;
   }
-  cout << "\tnumber of rules: " << cfg.size() + csa.sigma << endl;
-  cout << "\tstart rule size: " << cfg[start_rule].size() << endl;
-  cout << "\ttotal non-start size: " << total_size - cfg[start_rule].size() << endl;
-  cout << "\ttotal size: " << total_size << endl;
-  timer.endTask();
-
-  // regenerate the input file from the CFG for verification
-  timer.startTask();
-  cout << "printing CFG" << endl;
-  printCfg(csa, cfg, start_rule);
-  timer.endTask();
 
-  return 1;
+  return 0;
 }
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "mr-cfg/interval.hpp"
+
+using namespace std;
+using namespace mr_cfg;
+
+
+// the number of positions the intervals are in
+const uint32_t N = 1 << 16;
+// the number of updates the writer makes between publishes
+const size_t PUBLISH_INTERVAL = 64;
+// the number of positions the readers stab
+const size_t NUM_QUERIES = 512;
+// the number of reader threads
+const unsigned NUM_READERS = 3;
+
+
+//! An interval of a laminar family.
+struct Interval
+{
+  uint32_t begin;
+  uint32_t end;
+};
+
+
+//! Generates a random laminar family of intervals in [0, N-1) in which every
+//  interval precedes the intervals nested in it.
+vector<Interval> generateIntervals(mt19937& rng) {
+  vector<Interval> intervals;
+  queue<Interval> parents;
+  parents.push({0, N-2});
+  while (!parents.empty()) {
+    const Interval parent = parents.front();
+    parents.pop();
+    // place up to three disjoint children in the parent
+    uint32_t begin = parent.begin + 1;
+    for (int c = 0; c < 3 && begin + 2 < parent.end; ++c) {
+      uniform_int_distribution<uint32_t> end(begin + 1, parent.end - 1);
+      const Interval child{begin, end(rng)};
+      intervals.push_back(child);
+      parents.push(child);
+      begin = child.end + 2;
+    }
+  }
+  return intervals;
+}
+
+
+//! Checks that readers stabbing the concurrent data-structure while a writer
+//  updates and publishes it always see a published state, and that the final
+//  state matches the ONLINE data-structure's.
+int main()
+{
+
+  mt19937 rng(0);
+  const vector<Interval> intervals = generateIntervals(rng);
+  vector<uint32_t> queries(NUM_QUERIES);
+  uniform_int_distribution<uint32_t> position(0, N-1);
+  for (uint32_t& q: queries) {
+    q = position(rng);
+  }
+
+  // the results of the queries after each publish, computed with ONLINE; a
+  // result of the max ID means NULL
+  const uint64_t null_id = numeric_limits<uint64_t>::max();
+  const size_t num_publishes =
+    (intervals.size() + PUBLISH_INTERVAL - 1) / PUBLISH_INTERVAL;
+  vector<vector<uint64_t>> expected(num_publishes + 1, vector<uint64_t>(NUM_QUERIES, null_id));
+  OnlineNestedIntervalStabber<uint64_t, uint32_t> online;
+  for (size_t k = 0; k < intervals.size(); ++k) {
+    online.update(intervals[k].begin, intervals[k].end, k);
+    if ((k+1) % PUBLISH_INTERVAL == 0 || k+1 == intervals.size()) {
+      const size_t p = (k + PUBLISH_INTERVAL) / PUBLISH_INTERVAL;
+      for (size_t q = 0; q < NUM_QUERIES; ++q) {
+        const uint64_t* id = online.stab(queries[q]);
+        expected[p][q] = id == NULL ? null_id : *id;
+      }
+    }
+  }
+
+  // the writer updates and publishes while the readers stab; publish swaps the
+  // new snapshot in before it returns, so the number of publishes started is
+  // counted separately from the number finished
+  ConcurrentNestedIntervalStabber<uint64_t, uint32_t> concurrent;
+  atomic<size_t> publishing = 0;
+  atomic<size_t> published = 0;
+  atomic<uint64_t> mismatches = 0;
+  vector<thread> readers;
+  for (unsigned t = 0; t < NUM_READERS; ++t) {
+    readers.emplace_back([&]() {
+      while (published.load() < num_publishes) {
+        for (size_t q = 0; q < NUM_QUERIES; ++q) {
+          // the snapshot stabbed was at least the last one published before
+          // the first load and at most the last one started before the second
+          const size_t before = published.load();
+          const uint64_t* result = concurrent.stab(queries[q]);
+          const size_t after = publishing.load();
+          const uint64_t id = result == NULL ? null_id : *result;
+          bool found = false;
+          for (size_t p = before; p <= after && !found; ++p) {
+            found = expected[p][q] == id;
+          }
+          mismatches += !found;
+        }
+      }
+    });
+  }
+  for (size_t k = 0; k < intervals.size(); ++k) {
+    concurrent.update(intervals[k].begin, intervals[k].end, k);
+    if ((k+1) % PUBLISH_INTERVAL == 0 || k+1 == intervals.size()) {
+      publishing += 1;
+      concurrent.publish();
+      published += 1;
+      // give the readers a chance to stab this snapshot
+      this_thread::yield();
+    }
+  }
+  for (thread& reader: readers) {
+    reader.join();
+  }
+  if (mismatches != 0) {
+    cerr << mismatches << " concurrent results weren't from a published state"
+         << endl;
+    return 1;
+  }
+
+  // the final state is the ONLINE data-structure's
+  vector<uint32_t> all(N);
+  for (uint32_t i = 0; i < N; ++i) {
+    all[i] = i;
+  }
+  vector<const uint64_t*> results;
+  concurrent.stabMany(all, results);
+  for (uint32_t i = 0; i < N; ++i) {
+    const uint64_t* id = online.stab(i);
+    if ((id == NULL) != (results[i] == NULL) || (id != NULL && *id != *results[i])) {
+      cerr << "the concurrent result of " << i << " differs from ONLINE" << endl;
+      return 1;
+    }
+  }
+  return 0;
+
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <sdsl/construct.hpp>
+#include <sdsl/csa_wt.hpp>
+
+#include "mr-cfg/rlbwt.hpp"
+
+using namespace std;
+using namespace sdsl;
+using namespace mr_cfg;
+
+
+// the number of threads that access the ISA at once
+const unsigned NUM_THREADS = 4;
+
+
+//! Checks that threads accessing the ISA of a run-length CSA at the same time
+//  get the same values as a csa_wt, i.e. that the threads' ISA caches don't
+//  interfere.
+int main()
+{
+
+  // a repetitive text, so the BWT has long runs
+  mt19937_64 rng(0);
+  uniform_int_distribution<int> character(0, 3);
+  string unit;
+  for (int k = 0; k < 1000; ++k) {
+    unit.push_back("acgt"[character(rng)]);
+  }
+  string text_string;
+  for (int k = 0; k < 16; ++k) {
+    text_string += unit;
+    text_string[text_string.size() - 1 - k] = 'n';
+  }
+  int_vector<8> text(text_string.size());
+  for (size_t k = 0; k < text_string.size(); ++k) {
+    text[k] = text_string[k];
+  }
+
+  csa_wt<wt_huff<>> expected;
+  construct_im(expected, text);
+  RunLengthCsa csa(text, 8, 256);
+
+  // each thread accesses the ISA in text order from a different start, so the
+  // threads' accesses interleave
+  vector<uint64_t> mismatches(NUM_THREADS, 0);
+  vector<thread> threads;
+  for (unsigned t = 0; t < NUM_THREADS; ++t) {
+    threads.emplace_back([&, t]() {
+      const uint64_t n = csa.size();
+      for (int pass = 0; pass < 4; ++pass) {
+        for (uint64_t k = 0; k < n; ++k) {
+          const uint64_t i = (k + t * n / NUM_THREADS) % n;
+          mismatches[t] += csa.isa[i] != expected.isa[i];
+          mismatches[t] += csa.text[i] != expected.text[i];
+        }
+      }
+    });
+  }
+  for (thread& t: threads) {
+    t.join();
+  }
+
+  for (unsigned t = 0; t < NUM_THREADS; ++t) {
+    if (mismatches[t] != 0) {
+      cerr << "thread " << t << ": " << mismatches[t]
+           << " ISA or text values differ from csa_wt" << endl;
+      return 1;
+    }
+  }
+  return 0;
+
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2022 Alan Cleary
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>  // sort
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <sdsl/construct.hpp>
+#include <sdsl/csa_wt.hpp>
+
+#include "mr-cfg/file.hpp"
+#include "mr-cfg/rlbwt.hpp"
+
+using namespace std;
+using namespace sdsl;
+using namespace mr_cfg;
+
+
+// the number of random intervals whose symbols are compared
+const uint64_t NUM_INTERVALS = 10000;
+
+
+//! Gets the distinct symbols of a BWT interval with their ranks at the
+//  interval's boundaries, sorted by symbol.
+template <class bwt_type>
+vector<tuple<uint8_t, uint64_t, uint64_t>>
+symbols(const bwt_type& bwt, uint64_t sigma, uint64_t i, uint64_t j) {
+  uint64_t k;
+  vector<typename bwt_type::value_type> cs(sigma);
+  vector<typename bwt_type::size_type> rank_c_i(sigma);
+  vector<typename bwt_type::size_type> rank_c_j(sigma);
+  interval_symbols(bwt, i, j, k, cs, rank_c_i, rank_c_j);
+  vector<tuple<uint8_t, uint64_t, uint64_t>> result;
+  for (uint64_t t = 0; t < k; ++t) {
+    result.emplace_back(cs[t], rank_c_i[t], rank_c_j[t]);
+  }
+  sort(result.begin(), result.end());
+  return result;
+}
+
+
+//! Compares the access, rank, select, and interval_symbols results of a
+//  run-length BWT to those of a csa_wt's wavelet tree and returns the number
+//  of results that differ.
+uint64_t compare(const int_vector<8>& text) {
+  csa_wt<wt_huff<>> csa;
+  construct_im(csa, text);
+  const auto& expected = csa.wavelet_tree;
+  RunLengthBwt bwt(csa);
+  const uint64_t n = csa.size();
+  uint64_t mismatches = 0;
+
+  for (uint64_t i = 0; i < n; ++i) {
+    mismatches += bwt[i] != expected[i];
+  }
+  for (uint64_t c_id = 0; c_id < csa.sigma; ++c_id) {
+    const uint8_t c = csa.comp2char[c_id];
+    for (uint64_t i = 0; i <= n; ++i) {
+      mismatches += bwt.rank(i, c) != expected.rank(i, c);
+    }
+    const uint64_t count = expected.rank(n, c);
+    for (uint64_t k = 1; k <= count; ++k) {
+      mismatches += bwt.select(k, c) != expected.select(k, c);
+    }
+  }
+
+  // every interval of a small text, and random intervals of a larger one
+  mt19937_64 rng(0);
+  uniform_int_distribution<uint64_t> position(0, n);
+  const uint64_t num_intervals = n*n <= NUM_INTERVALS ? n*n : NUM_INTERVALS;
+  for (uint64_t t = 0; t < num_intervals; ++t) {
+    uint64_t i = n*n <= NUM_INTERVALS ? t / n : position(rng);
+    uint64_t j = n*n <= NUM_INTERVALS ? t % n + 1 : position(rng);
+    if (i > j) {
+      swap(i, j);
+    }
+    mismatches += symbols(bwt, csa.sigma, i, j) !=
+      symbols(expected, csa.sigma, i, j);
+  }
+
+  return mismatches;
+}
+
+
+//! Checks that a run-length BWT answers the wavelet tree queries LCP-interval
+//  enumeration uses like a csa_wt's wavelet tree does, for every fixture.
+int main(int argc, char* argv[])
+{
+
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <FIXTURE DIRECTORY>" << endl;
+    return 1;
+  }
+
+  bool failed = false;
+  for (const auto& entry: filesystem::directory_iterator(argv[1])) {
+    if (entry.path().extension() != ".txt") {
+      continue;
+    }
+    const uint64_t mismatches = compare(load_text(entry.path().string()));
+    if (mismatches != 0) {
+      cerr << entry.path().filename().string() << ": " << mismatches
+           << " results differ from csa_wt" << endl;
+      failed = true;
+    }
+  }
+  return failed ? 1 : 0;
+
+}
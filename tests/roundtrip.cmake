@@ -0,0 +1,40 @@
+# Runs MR-CFG on a file and checks that the grammar it prints reproduces the
+# file and that the grammar has the expected number of rules and total size.
+# If ERROR is given, MR-CFG is instead expected to fail with that message.
+#
+# Usage: cmake -DMR_CFG=<BINARY> -DALGORITHM=<ALGORITHM> -DFILE=<FILE>
+#              -DTHREADS=<THREADS> -DSOURCE=<SOURCE> -DCSA=<CSA>
+#              [-DRULES=<RULES> -DSIZE=<SIZE>] [-DERROR=<MESSAGE>]
+#              -P roundtrip.cmake
+
+execute_process(
+  COMMAND ${MR_CFG} ${ALGORITHM} ${FILE} ${THREADS} ${SOURCE} ${CSA}
+  OUTPUT_VARIABLE output
+  ERROR_VARIABLE grammar
+  RESULT_VARIABLE result)
+
+if (DEFINED ERROR)
+  if (result EQUAL 0 OR NOT grammar MATCHES "${ERROR}")
+    message(FATAL_ERROR "expected the error \"${ERROR}\"; got:\n${grammar}")
+  endif()
+  return()
+endif()
+
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "MR-CFG failed (${result}):\n${output}\n${grammar}")
+endif()
+
+# the grammar is printed to the standard error
+file(READ ${FILE} text)
+if (NOT grammar STREQUAL text)
+  message(FATAL_ERROR "the grammar doesn't reproduce ${FILE}")
+endif()
+
+string(REGEX MATCH "number of rules: ([0-9]+)" _ "${output}")
+set(rules ${CMAKE_MATCH_1})
+string(REGEX MATCH "total size: ([0-9]+)" _ "${output}")
+set(size ${CMAKE_MATCH_1})
+if (NOT rules STREQUAL RULES OR NOT size STREQUAL SIZE)
+  message(FATAL_ERROR
+    "expected ${RULES} rules of total size ${SIZE}; got ${rules} rules of total size ${size}")
+endif()